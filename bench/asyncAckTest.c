@@ -0,0 +1,109 @@
+/**
+ * @file asyncAckTest.c
+ * @brief Test of the ack collection of sdlPoll()
+ *
+ * sdlPoll() searches the ack of the pending frame and then receives data
+ * frames with sdlReceive(), which refills rxBuff: the ack is delivered by
+ * the line only during this second fill, behind a data frame, and must be
+ * left in rxBuff for the next sdlPoll() instead of being removed as an old
+ * ack.
+ *
+ * Build with "make bench" and run as "asyncAckTest".
+ *
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <string.h>
+
+#define WIRE_LEN 1024
+
+uint32_t sdlTimeTick(){
+    return 0;
+}
+
+serial_line_handle lineA; //asynchronous sender
+serial_line_handle lineB; //receiver, answering with an ack and a data frame
+
+//bytes travelling from A to B
+uint8_t wireAB[WIRE_LEN];
+uint32_t wireABIn, wireABOut;
+
+//bytes travelling from B to A, the ones after wireBARel are held back
+uint8_t wireBA[WIRE_LEN];
+uint32_t wireBAIn, wireBAOut, wireBARel;
+
+uint8_t txA(uint8_t byte){
+    if(wireABIn==WIRE_LEN) return 0;
+    wireAB[wireABIn++]=byte;
+    return 1;
+}
+
+uint8_t rxB(uint8_t* byte){
+    if(wireABOut==wireABIn) return 0;
+    *byte=wireAB[wireABOut++];
+    return 1;
+}
+
+uint8_t txB(uint8_t byte){
+    if(wireBAIn==WIRE_LEN) return 0;
+    wireBA[wireBAIn++]=byte;
+    return 1;
+}
+
+//the held bytes are released when the line finds nothing, so they arrive
+//in the following fill of rxBuff
+uint8_t rxA(uint8_t* byte){
+    if(wireBAOut==wireBARel){
+        wireBARel=wireBAIn;
+        return 0;
+    }
+    *byte=wireBA[wireBAOut++];
+    return 1;
+}
+
+int main(){
+    sdlInitLine(&lineA,txA,rxA,10,0);
+    sdlInitLine(&lineB,txB,rxB,10,0);
+
+    uint8_t request[]="request";
+    uint8_t reply[]="reply";
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    uint32_t errors=0;
+
+    if(!sdlSendAsync(&lineA,request,sizeof(request),1)){
+        printf("async send failed\n");
+        return 1;
+    }
+
+    //B gets the request (sending the ack) and replies
+    uint32_t len=sdlReceive(&lineB,rxPayload,sizeof(rxPayload));
+    if(len!=sizeof(request) || memcmp(rxPayload,request,len)){
+        printf("request not received\n");
+        errors++;
+    }
+    sdlSend(&lineB,reply,sizeof(reply),0);
+
+    //the ack search of sdlPoll() finds nothing, the ack and the reply arrive
+    //while sdlPoll() receives data frames
+    len=sdlPoll(&lineA,rxPayload,sizeof(rxPayload));
+    if(len!=sizeof(reply) || memcmp(rxPayload,reply,len)){
+        printf("reply not received\n");
+        errors++;
+    }
+    if(sdlTxState(&lineA)!=SDL_TX_WAIT_ACK){
+        printf("ack collected too early\n");
+        errors++;
+    }
+
+    //the ack is still in rxBuff
+    sdlPoll(&lineA,rxPayload,sizeof(rxPayload));
+    if(sdlTxState(&lineA)!=SDL_TX_ACKED){
+        printf("ack of the pending frame removed\n");
+        errors++;
+    }
+
+    printf("%u errors\n",errors);
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file batchBench.c
+ * @brief Benchmark of the batch reception
+ *
+ * A backlog of 1000 frames waiting inside the driver is drained by calling
+ * sdlReceive() in a loop and by calling sdlReceiveBatch(), with 8 and 32
+ * bytes frames, with and without acks, measuring the time spent per frame
+ * and counting the ack bytes sent back (which must be the same).
+ *
+ * Build with "make bench" and run as "batchBench [rounds]".
+ *
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BACKLOG 1000
+#define WIRE_LEN (1<<18)
+#define BATCH_DESCS 64
+
+uint64_t nsNow(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000000ull+t.tv_nsec;
+}
+
+//only moved to give up the acks of the sender
+uint32_t tick;
+
+uint32_t sdlTimeTick(){
+    return tick;
+}
+
+uint8_t wire[WIRE_LEN];
+uint32_t wireIn, wireOut;
+uint32_t ackBytes;
+uint32_t rounds=50;
+
+uint8_t txSender(uint8_t byte){
+    if(wireIn==WIRE_LEN) return 0;
+    wire[wireIn++]=byte;
+    return 1;
+}
+
+uint8_t rxSender(uint8_t* byte){
+    return 0;
+}
+
+uint8_t txReceiver(uint8_t byte){
+    ackBytes++;
+    return 1;
+}
+
+uint8_t rxReceiver(uint8_t* byte){
+    if(wireOut==wireIn) return 0;
+    *byte=wire[wireOut++];
+    return 1;
+}
+
+//fills the driver with the backlog
+void fillBacklog(uint32_t len, uint8_t ackWanted){
+    serial_line_handle sender;
+    //acks are never collected, the sender gives up every frame at once
+    sdlInitLine(&sender,txSender,rxSender,0,0);
+
+    uint8_t payload[SDL_MAX_PAY_LEN];
+    wireIn=wireOut=0;
+    for(uint32_t n=0;n<BACKLOG;n++){
+        memset(payload,n%0x70,len);
+        sdlSendAsync(&sender,payload,len,ackWanted);
+        tick++;
+        sdlCheckTimeout(&sender);
+    }
+}
+
+//drains the backlog, returns the number of received frames
+uint32_t drain(serial_line_handle* receiver, uint8_t batch){
+    static uint8_t arena[BATCH_DESCS*SDL_MAX_PAY_LEN];
+    sdl_frame_desc descs[BATCH_DESCS];
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    uint32_t frames=0;
+
+    while(1){
+        uint32_t n;
+        if(batch) n=sdlReceiveBatch(receiver,descs,BATCH_DESCS,arena,sizeof(arena));
+        else n=sdlReceive(receiver,rxPayload,sizeof(rxPayload)) ? 1 : 0;
+        frames+=n;
+        if(!n && wireOut==wireIn && !sdlRxPending(receiver)) break;
+    }
+
+    return frames;
+}
+
+void run(uint32_t len, uint8_t ackWanted){
+    uint64_t ns[2]={0,0};
+    uint32_t frames[2]={0,0};
+    uint32_t acks[2]={0,0};
+
+    for(uint32_t r=0;r<rounds;r++){
+        for(uint8_t batch=0;batch<2;batch++){
+            serial_line_handle receiver;
+            sdlInitLine(&receiver,txReceiver,rxReceiver,10,1);
+            fillBacklog(len,ackWanted);
+            ackBytes=0;
+
+            uint64_t start=nsNow();
+            frames[batch]+=drain(&receiver,batch);
+            ns[batch]+=nsNow()-start;
+            acks[batch]+=ackBytes;
+        }
+    }
+
+    printf("%-7s %2u bytes frames: sdlReceive() %5.0f ns/frame, sdlReceiveBatch() %5.0f ns/frame (%4.1f%% less), %u/%u frames, %u/%u ack bytes per round\n",
+           ackWanted ? "acked" : "unacked",len,(double)ns[0]/frames[0],(double)ns[1]/frames[1],100.0-100.0*ns[1]*frames[0]/((double)ns[0]*frames[1]),
+           frames[0]/rounds,frames[1]/rounds,acks[0]/rounds,acks[1]/rounds);
+}
+
+int main(int argc, char** argv){
+    if(argc>1) rounds=atoi(argv[1]);
+
+    uint32_t lens[]={8,32};
+    for(uint8_t ackWanted=0;ackWanted<2;ackWanted++){
+        for(uint32_t l=0;l<sizeof(lens)/sizeof(lens[0]);l++) run(lens[l],ackWanted);
+    }
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file burstBench.c
+ * @brief Benchmark of the burst transmission of the queue
+ *
+ * The same frames are sent on a line with sdlSend() (byte by byte through
+ * txFunc) and through the queue drained by sdlTxDrain() with a burst
+ * function, counting the bytes written on the line and the driver calls
+ * (txFunc or burst function calls) per frame, then they are received on
+ * another line to verify them.
+ *
+ * Build with "make bench" and run as "burstBench [frames]".
+ *
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define WIRE_LEN (1<<22)
+
+uint64_t nsNow(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000000ull+t.tv_nsec;
+}
+
+uint32_t sdlTimeTick(){
+    return nsNow()/1000000;
+}
+
+serial_line_handle txLine;
+serial_line_handle rxLine;
+uint32_t frameNum=100000;
+
+//line bytes and driver calls
+uint8_t wire[WIRE_LEN];
+uint32_t wireIn, wireOut;
+uint32_t driverCalls;
+
+uint8_t txByte(uint8_t byte){
+    driverCalls++;
+    if(wireIn==WIRE_LEN) return 0;
+    wire[wireIn++]=byte;
+    return 1;
+}
+
+uint32_t txBurst(uint8_t* buff, uint32_t len){
+    driverCalls++;
+    if(len>(WIRE_LEN-wireIn)) return 0;
+    for(uint32_t b=0;b<len;b++) wire[wireIn+b]=buff[b];
+    wireIn+=len;
+    return len;
+}
+
+uint8_t rxByte(uint8_t* byte){
+    if(wireOut==wireIn) return 0;
+    *byte=wire[wireOut++];
+    return 1;
+}
+
+//payload of frame n (the first byte is the frame number)
+void makePayload(uint32_t n, uint8_t* payload, uint32_t len){
+    payload[0]=(uint8_t)n;
+    for(uint32_t b=1;b<len;b++) payload[b]=(uint8_t)(n*31+b);
+}
+
+//receives the frames sent on the wire, returns the number of errors
+uint32_t verify(uint32_t len){
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    uint8_t expected[SDL_MAX_PAY_LEN];
+    uint32_t errors=0;
+
+    for(uint32_t n=0;n<frameNum;n++){
+        makePayload(n,expected,len);
+        uint32_t rxLen;
+        //duplicated frames aren't possible, 0 only means that the wire is empty
+        while(!(rxLen=sdlReceive(&rxLine,rxPayload,sizeof(rxPayload))) && sdlRxPending(&rxLine));
+        uint8_t ok=(rxLen==len);
+        for(uint32_t b=0;ok && b<len;b++) ok=(rxPayload[b]==expected[b]);
+        if(!ok) errors++;
+    }
+
+    return errors;
+}
+
+//sends and verifies the frames, returns the number of errors
+uint32_t run(uint32_t len, uint8_t burst){
+    uint8_t payload[SDL_MAX_PAY_LEN];
+    wireIn=wireOut=0;
+    driverCalls=0;
+
+    sdlSetTxBurstFunc(&txLine,burst ? txBurst : NULL);
+
+    uint64_t start=nsNow();
+    for(uint32_t n=0;n<frameNum;n++){
+        makePayload(n,payload,len);
+        if(burst){
+            //draining when the queue is full
+            while(!sdlEnqueue(&txLine,payload,len,0)) sdlTxDrain(&txLine);
+        }else{
+            sdlSend(&txLine,payload,len,0);
+        }
+    }
+    if(burst) sdlTxDrain(&txLine);
+    double ns=(double)(nsNow()-start)/frameNum;
+
+    uint32_t bytes=wireIn;
+    uint32_t calls=driverCalls;
+    uint32_t errors=verify(len);
+    printf("%3u bytes payload, %-12s %6.2f bytes/frame, %8.4f driver calls/frame, %6.1f ns/frame, %u errors\n",
+           len,burst ? "sdlTxDrain:" : "sdlSend:",(double)bytes/frameNum,(double)calls/frameNum,ns,errors);
+
+    return errors;
+}
+
+int main(int argc, char** argv){
+    if(argc>1) frameNum=atoi(argv[1]);
+    //the wire must hold all the frames of a run
+    if(frameNum>(WIRE_LEN/SDL_LINE_BUFF_LEN(SDL_MAX_PAY_LEN))) frameNum=WIRE_LEN/SDL_LINE_BUFF_LEN(SDL_MAX_PAY_LEN);
+
+    sdlInitLine(&txLine,txByte,NULL,10,0);
+    sdlInitLine(&rxLine,NULL,rxByte,10,0);
+
+    uint32_t lens[]={4,16,64};
+    uint32_t errors=0;
+    for(uint32_t l=0;l<sizeof(lens)/sizeof(lens[0]);l++){
+        errors+=run(lens[l],0);
+        errors+=run(lens[l],1);
+    }
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file compactBench.c
+ * @brief Benchmark of the compact header on short payloads
+ *
+ * Frames wanting an ack are exchanged between two lines with the full and
+ * with the compact header, counting the bytes written on the line for the
+ * frames and for their acks, and the frames per second a 115200 baud line
+ * (11520 bytes per second each way) could carry with that overhead.
+ *
+ * Build with "make bench" and run as "compactBench [frames]".
+ *
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WIRE_LEN 1024
+#define LINE_BYTES_PER_SEC 11520
+
+uint32_t sdlTimeTick(){
+    return 0;
+}
+
+serial_line_handle lineA; //sender
+serial_line_handle lineB; //receiver, answering with acks
+uint32_t frameNum=10000;
+
+//bytes travelling between the lines (each frame is read before the next one)
+uint8_t wireAB[WIRE_LEN];
+uint32_t wireABIn, wireABOut;
+uint8_t wireBA[WIRE_LEN];
+uint32_t wireBAIn, wireBAOut;
+uint64_t bytesAB, bytesBA;
+
+uint8_t txA(uint8_t byte){
+    if(wireABIn==WIRE_LEN) return 0;
+    wireAB[wireABIn++]=byte;
+    bytesAB++;
+    return 1;
+}
+
+uint8_t rxB(uint8_t* byte){
+    if(wireABOut==wireABIn) return 0;
+    *byte=wireAB[wireABOut++];
+    return 1;
+}
+
+uint8_t txB(uint8_t byte){
+    if(wireBAIn==WIRE_LEN) return 0;
+    wireBA[wireBAIn++]=byte;
+    bytesBA++;
+    return 1;
+}
+
+uint8_t rxA(uint8_t* byte){
+    if(wireBAOut==wireBAIn) return 0;
+    *byte=wireBA[wireBAOut++];
+    return 1;
+}
+
+//exchanges the frames, returns the number of errors
+uint32_t run(uint32_t len, uint8_t compact){
+    uint8_t payload[SDL_MAX_PAY_LEN];
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    uint32_t errors=0;
+
+    sdlSetCompactHeader(&lineA,compact);
+    bytesAB=bytesBA=0;
+
+    for(uint32_t n=0;n<frameNum;n++){
+        wireABIn=wireABOut=wireBAIn=wireBAOut=0;
+        for(uint32_t b=0;b<len;b++) payload[b]=(uint8_t)(n+b);
+
+        if(!sdlSendAsync(&lineA,payload,len,1)) errors++;
+        if(sdlReceive(&lineB,rxPayload,sizeof(rxPayload))!=len) errors++;
+        sdlPoll(&lineA,rxPayload,sizeof(rxPayload));
+        if(sdlTxState(&lineA)!=SDL_TX_ACKED) errors++;
+    }
+
+    double frameBytes=(double)bytesAB/frameNum;
+    double ackBytes=(double)bytesBA/frameNum;
+    printf("%3u bytes payload, %-8s %6.2f bytes/frame, %5.2f bytes/ack, %6.0f frames/s at 115200 baud, %u errors\n",
+           len,compact ? "compact:" : "full:",frameBytes,ackBytes,LINE_BYTES_PER_SEC/frameBytes,errors);
+
+    return errors;
+}
+
+int main(int argc, char** argv){
+    if(argc>1) frameNum=atoi(argv[1]);
+
+    sdlInitLine(&lineA,txA,rxA,10,0);
+    sdlInitLine(&lineB,txB,rxB,10,0);
+
+    uint32_t lens[]={1,6,16,64};
+    uint32_t errors=0;
+    for(uint32_t l=0;l<sizeof(lens)/sizeof(lens[0]);l++){
+        errors+=run(lens[l],0);
+        errors+=run(lens[l],1);
+    }
+
+    return errors ? 1 : 0;
+}
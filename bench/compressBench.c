@@ -0,0 +1,115 @@
+/**
+ * @file compressBench.c
+ * @brief Benchmark of the payload compression
+ *
+ * Three kinds of payloads (64 bytes telemetry frames made of repeated
+ * samples, 80 bytes JSON-like configuration frames and 128 bytes of random
+ * data) are sent with and without compression, counting the bytes written
+ * on the line to get the goodput of a 115200 baud line (11520 bytes per
+ * second), and the time spent per frame to encode and decode them.
+ *
+ * Build with "make bench" and run as "compressBench [frames]".
+ *
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WIRE_LEN 1024
+#define LINE_BYTES_PER_SEC 11520
+
+uint64_t nsNow(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000000ull+t.tv_nsec;
+}
+
+uint32_t sdlTimeTick(){
+    return nsNow()/1000000;
+}
+
+serial_line_handle txLine;
+serial_line_handle rxLine;
+uint32_t frameNum=100000;
+
+//bytes on the line (each frame is read before the next one)
+uint8_t wire[WIRE_LEN];
+uint32_t wireIn, wireOut;
+uint64_t wireBytes;
+
+uint8_t txByte(uint8_t byte){
+    if(wireIn==WIRE_LEN) return 0;
+    wire[wireIn++]=byte;
+    wireBytes++;
+    return 1;
+}
+
+uint8_t rxByte(uint8_t* byte){
+    if(wireOut==wireIn) return 0;
+    *byte=wire[wireOut++];
+    return 1;
+}
+
+//payload n of the given kind, returns its length
+uint32_t makePayload(uint32_t kind, uint32_t n, uint8_t* payload){
+    if(kind==0){
+        //16 samples of 4 bytes which barely change
+        for(uint32_t s=0;s<16;s++){
+            uint32_t sample=1000+(n%3)+(s%2);
+            memcpy(&payload[4*s],&sample,4);
+        }
+        return 64;
+    }
+    if(kind==1){
+        return snprintf((char*)payload,SDL_MAX_PAY_LEN,"{\"id\":%u,\"mode\":\"auto\",\"rate\":%u,\"gain\":[1,1,1,1],\"name\":\"sensor_%u\",\"en\":true}",n%1000,100+n%7,n%4);
+    }
+    for(uint32_t b=0;b<128;b++) payload[b]=(uint8_t)rand();
+    return 128;
+}
+
+//sends and verifies the frames, returns the number of errors
+uint32_t run(uint32_t kind, uint8_t compress){
+    static const char* names[]={"telemetry","json config","random"};
+    uint8_t payload[SDL_MAX_PAY_LEN];
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    uint64_t payBytes=0;
+    uint32_t errors=0;
+
+    sdlSetCompression(&txLine,compress);
+    wireBytes=0;
+    srand(1);
+
+    uint64_t start=nsNow();
+    for(uint32_t n=0;n<frameNum;n++){
+        wireIn=wireOut=0;
+        uint32_t len=makePayload(kind,n,payload);
+        payBytes+=len;
+        sdlSend(&txLine,payload,len,0);
+        if(sdlReceive(&rxLine,rxPayload,sizeof(rxPayload))!=len || memcmp(rxPayload,payload,len)) errors++;
+    }
+    double ns=(double)(nsNow()-start)/frameNum;
+
+    double efficiency=(double)payBytes/wireBytes;
+    printf("%-11s %-16s %6.1f wire bytes/frame, goodput %6.0f B/s at 115200 baud, %6.0f ns/frame, %u errors\n",
+           names[kind],compress ? "compressed:" : "uncompressed:",(double)wireBytes/frameNum,efficiency*LINE_BYTES_PER_SEC,ns,errors);
+
+    return errors;
+}
+
+int main(int argc, char** argv){
+    if(argc>1) frameNum=atoi(argv[1]);
+
+    sdlInitLine(&txLine,txByte,NULL,10,0);
+    sdlInitLine(&rxLine,NULL,rxByte,10,0);
+
+    uint32_t errors=0;
+    for(uint32_t kind=0;kind<3;kind++){
+        errors+=run(kind,0);
+        errors+=run(kind,1);
+    }
+
+    return errors ? 1 : 0;
+}
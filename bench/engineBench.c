@@ -0,0 +1,166 @@
+/**
+ * @file engineBench.c
+ * @brief Multi-line engine benchmark
+ * 
+ * Measures, on Linux, the cost of the sdlEngine.h/.c engine:
+ * Test 1 - Throughput with 1 to N service threads (one engine per thread,
+ *          each one looping unacked frames between its own line pairs)
+ * Test 2 - Cost of the idle lines inside sdlEngineService(), both never
+ *          notified and notified without new bytes
+ * Test 3 - CPU used by a thread waiting on sdlEngineWaitEpoll() with many
+ *          idle lines (pipes registered on epoll)
+ * 
+ * Build with "make bench" and run as "engineBench [maxThreads]".
+ * 
+ */
+
+#include "sdlEngine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#define PAIRS_PER_ENGINE 8 //line pairs serviced by every thread
+#define IDLE_LINES 256 //lines of the idle tests
+#define TEST_NS 1000000000ull //duration of the timed tests
+
+uint64_t nsNow(clockid_t clock){
+    struct timespec t;
+    clock_gettime(clock,&t);
+    return (uint64_t)t.tv_sec*1000000000ull+t.tv_nsec;
+}
+
+uint32_t sdlTimeTick(){
+    return nsNow(CLOCK_MONOTONIC)/1000000;
+}
+
+//the line receiving what the thread is sending (txFunc has no line argument)
+_Thread_local serial_line_handle* peer;
+
+uint8_t txLoop(uint8_t byte){
+    return sdlRxPush(peer,&byte,1);
+}
+
+//frames received by the thread engine
+_Thread_local uint64_t rxFrames;
+
+void countFrame(sdl_engine_handle* engine, uint32_t id, uint8_t* buff, uint32_t len){
+    rxFrames++;
+}
+
+typedef struct{
+    sdl_engine_handle engine;
+    serial_line_handle lines[2*PAIRS_PER_ENGINE];
+    uint64_t frames;
+    pthread_t thread;
+}bench_thread;
+
+void* throughputThread(void* arg){
+    bench_thread* bt=arg;
+    uint8_t payload[16]={0};
+    uint32_t ids[2*PAIRS_PER_ENGINE];
+
+    sdlEngineInit(&bt->engine,countFrame,NULL);
+    for(uint32_t l=0;l<2*PAIRS_PER_ENGINE;l++){
+        sdlInitLine(&bt->lines[l],txLoop,NULL,10,0);
+        ids[l]=sdlEngineAddLine(&bt->engine,&bt->lines[l]);
+    }
+
+    uint64_t end=nsNow(CLOCK_MONOTONIC)+TEST_NS;
+    while(nsNow(CLOCK_MONOTONIC)<end){
+        for(uint32_t p=0;p<PAIRS_PER_ENGINE;p++){
+            peer=&bt->lines[2*p+1];
+            sdlEngineSend(&bt->engine,ids[2*p],payload,sizeof(payload),0);
+            sdlEngineNotify(&bt->engine,ids[2*p+1]);
+        }
+        sdlEngineService(&bt->engine);
+    }
+    bt->frames=rxFrames;
+
+    return NULL;
+}
+
+void testThroughput(uint32_t maxThreads){
+    printf("Test 1 - unacked 16 bytes frames, %d line pairs per thread\n",PAIRS_PER_ENGINE);
+    for(uint32_t threads=1;threads<=maxThreads;threads*=2){
+        bench_thread* bts=calloc(threads,sizeof(bench_thread));
+        for(uint32_t t=0;t<threads;t++) pthread_create(&bts[t].thread,NULL,throughputThread,&bts[t]);
+        uint64_t frames=0;
+        for(uint32_t t=0;t<threads;t++){
+            pthread_join(bts[t].thread,NULL);
+            frames+=bts[t].frames;
+        }
+        printf("%2u threads: %.2f Mframes/s\n",threads,frames/1e6/(TEST_NS/1e9));
+        free(bts);
+    }
+}
+
+void testIdleService(){
+    sdl_engine_handle* engine=calloc(1,sizeof(sdl_engine_handle));
+    serial_line_handle* lines=calloc(IDLE_LINES,sizeof(serial_line_handle));
+    sdlEngineInit(engine,NULL,NULL);
+    for(uint32_t l=0;l<IDLE_LINES;l++){
+        sdlInitLine(&lines[l],txLoop,NULL,10,0);
+        sdlEngineAddLine(engine,&lines[l]);
+    }
+    sdlEngineService(engine);
+
+    printf("Test 2 - %d idle lines\n",IDLE_LINES);
+    uint32_t rounds=1000000;
+    uint64_t start=nsNow(CLOCK_MONOTONIC);
+    for(uint32_t r=0;r<rounds;r++) sdlEngineService(engine);
+    printf("service round, no line notified: %.1f ns\n",(double)(nsNow(CLOCK_MONOTONIC)-start)/rounds);
+
+    rounds=10000;
+    start=nsNow(CLOCK_MONOTONIC);
+    for(uint32_t r=0;r<rounds;r++){
+        for(uint32_t l=0;l<IDLE_LINES;l++) sdlEngineNotify(engine,l);
+        sdlEngineService(engine);
+    }
+    printf("notified line without new bytes: %.1f ns\n",(double)(nsNow(CLOCK_MONOTONIC)-start)/rounds/IDLE_LINES);
+
+    free(lines);
+    free(engine);
+}
+
+void testIdleEpoll(uint32_t lineNum){
+    sdl_engine_handle* engine=calloc(1,sizeof(sdl_engine_handle));
+    serial_line_handle* lines=calloc(lineNum,sizeof(serial_line_handle));
+    int (*pipes)[2]=calloc(lineNum,sizeof(int[2]));
+    int epfd=epoll_create1(0);
+    sdlEngineInit(engine,NULL,NULL);
+    for(uint32_t l=0;l<lineNum;l++){
+        sdlInitLine(&lines[l],txLoop,NULL,10,0);
+        struct epoll_event event={.events=EPOLLIN, .data.u32=sdlEngineAddLine(engine,&lines[l])};
+        if(pipe(pipes[l])) return;
+        epoll_ctl(epfd,EPOLL_CTL_ADD,pipes[l][0],&event);
+    }
+
+    uint64_t cpuStart=nsNow(CLOCK_PROCESS_CPUTIME_ID);
+    uint64_t end=nsNow(CLOCK_MONOTONIC)+TEST_NS;
+    while(nsNow(CLOCK_MONOTONIC)<end) sdlEngineWaitEpoll(engine,epfd,1);
+    printf("%3u idle lines, 1 ms epoll timeout: %.2f%% CPU\n",lineNum,100.0*(nsNow(CLOCK_PROCESS_CPUTIME_ID)-cpuStart)/TEST_NS);
+
+    for(uint32_t l=0;l<lineNum;l++){
+        close(pipes[l][0]);
+        close(pipes[l][1]);
+    }
+    close(epfd);
+    free(pipes);
+    free(lines);
+    free(engine);
+}
+
+int main(int argc, char** argv){
+    uint32_t maxThreads=(argc>1) ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    testThroughput(maxThreads);
+    testIdleService();
+    printf("Test 3 - waiting on epoll\n");
+    testIdleEpoll(1);
+    testIdleEpoll(IDLE_LINES);
+
+    return 0;
+}
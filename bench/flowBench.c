@@ -0,0 +1,130 @@
+/**
+ * @file flowBench.c
+ * @brief Benchmark of the credit based flow control
+ *
+ * A sender offers a 32 bytes frame every tick to a receiver behind a 512
+ * bytes driver FIFO, which reads one frame every 20 ticks: the bytes which
+ * find the FIFO full are dropped. The transfer of 2000 frames is simulated
+ * without flow control, with flow control and with flow control losing one
+ * frame out of three sent by the receiver (its CREDIT frames), counting the
+ * received frames, the dropped bytes, the bytes sent by the sender and the
+ * ticks needed to receive the last frame.
+ *
+ * Build with "make bench" and run as "flowBench".
+ *
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+
+#define FIFO_LEN 512
+#define REPLY_LEN 4096
+#define FRAME_NUM 2000
+#define PAY_LEN 32
+#define READ_PERIOD 20
+#define MAX_TICKS 1000000
+
+uint32_t tick;
+
+uint32_t sdlTimeTick(){
+    return tick;
+}
+
+//receiver driver FIFO (the bytes which don't fit are dropped)
+uint8_t fifo[FIFO_LEN];
+uint32_t fifoHead, fifoTail;
+uint32_t fifoDropped;
+uint32_t sentBytes;
+
+//bytes sent back by the receiver
+uint8_t reply[REPLY_LEN];
+uint32_t replyHead, replyTail;
+uint8_t loseCredits;
+uint8_t inFrame, dropFrame;
+uint32_t replyFrames;
+
+uint8_t txSender(uint8_t byte){
+    sentBytes++;
+    if((fifoTail-fifoHead)==FIFO_LEN){
+        fifoDropped++;
+        return 1;
+    }
+    fifo[fifoTail++%FIFO_LEN]=byte;
+    return 1;
+}
+
+uint8_t rxReceiver(uint8_t* byte){
+    if(fifoHead==fifoTail) return 0;
+    *byte=fifo[fifoHead++%FIFO_LEN];
+    return 1;
+}
+
+//loses one frame out of three if loseCredits is set (frames never share flags here)
+uint8_t txReceiver(uint8_t byte){
+    uint8_t drop=dropFrame;
+    if(byte==0x7E){
+        if(!inFrame){
+            inFrame=1;
+            dropFrame=loseCredits && !(++replyFrames%3);
+            drop=dropFrame;
+        }else{
+            inFrame=0;
+            dropFrame=0;
+        }
+    }
+    if(drop) return 1;
+
+    reply[replyTail++%REPLY_LEN]=byte;
+    return 1;
+}
+
+uint8_t rxSender(uint8_t* byte){
+    if(replyHead==replyTail) return 0;
+    *byte=reply[replyHead++%REPLY_LEN];
+    return 1;
+}
+
+void run(const char* name, uint8_t flowControl, uint8_t lose){
+    serial_line_handle sender;
+    serial_line_handle receiver;
+    sdlInitLine(&sender,txSender,rxSender,50,3);
+    sdlInitLine(&receiver,txReceiver,rxReceiver,50,3);
+    sdlSetFlowControl(&sender,flowControl);
+    sdlSetFlowControl(&receiver,flowControl);
+
+    fifoHead=fifoTail=fifoDropped=sentBytes=0;
+    replyHead=replyTail=replyFrames=0;
+    inFrame=dropFrame=0;
+    loseCredits=lose;
+    tick=0;
+
+    uint8_t payload[PAY_LEN];
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    uint32_t sent=0;
+    uint32_t received=0;
+    uint32_t lastRx=0;
+    //running until every frame is received or the FIFO is idle for a while
+    while(received<FRAME_NUM && tick<MAX_TICKS && (sent<FRAME_NUM || (tick-lastRx)<10*READ_PERIOD*FRAME_NUM/100)){
+        tick++;
+        if(sent<FRAME_NUM){
+            for(uint32_t b=0;b<PAY_LEN;b++) payload[b]=(uint8_t)(sent+b);
+            //held frames are offered again at the next tick
+            if(sdlSendAsync(&sender,payload,PAY_LEN,0)) sent++;
+        }
+        if(!(tick%READ_PERIOD) && sdlReceive(&receiver,rxPayload,sizeof(rxPayload))==PAY_LEN){
+            received++;
+            lastRx=tick;
+        }
+    }
+
+    printf("%-28s %4u/%u frames received, %6u bytes dropped by the FIFO, %6u bytes sent, last frame at tick %u\n",
+           name,received,FRAME_NUM,fifoDropped,sentBytes,lastRx);
+}
+
+int main(){
+    run("no flow control:",0,0);
+    run("flow control:",1,0);
+    run("flow control, credits lost:",1,1);
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file paceBench.c
+ * @brief Benchmark of the transmission pacing
+ *
+ * The wire moves 16 bytes per tick from the sender driver (a 64 bytes TX
+ * queue) to the 16 bytes UART FIFO of the peer, whose interrupt routine
+ * moves at most 12 bytes per tick to the receiving line: the bytes which
+ * find the FIFO full are lost. The sender offers a 32 bytes frame every
+ * tick for 100000 ticks, without pacing and with different rate limits,
+ * counting the received frames, the goodput and the FIFO overruns.
+ *
+ * Build with "make bench" and run as "paceBench".
+ *
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <string.h>
+
+#define WIRE_BYTES_PER_TICK 16
+#define FIFO_LEN 16
+#define ISR_BYTES_PER_TICK 12
+#define DRIVER_LEN 64
+#define RING_LEN 4096 //power of 2
+#define PAY_LEN 32
+#define TICKS 100000
+
+uint32_t tick;
+
+uint32_t sdlTimeTick(){
+    return tick;
+}
+
+//sender driver TX queue
+uint8_t driver[RING_LEN];
+uint32_t driverHead, driverTail;
+//peer UART FIFO
+uint8_t fifo[FIFO_LEN];
+uint32_t fifoHead, fifoTail;
+uint32_t fifoOverruns;
+//bytes moved by the peer interrupt routine
+uint8_t isr[RING_LEN];
+uint32_t isrHead, isrTail;
+
+uint8_t txSender(uint8_t byte){
+    if((driverTail-driverHead)==RING_LEN) return 0;
+    driver[driverTail++%RING_LEN]=byte;
+    return 1;
+}
+
+uint8_t rxReceiver(uint8_t* byte){
+    if(isrHead==isrTail) return 0;
+    *byte=isr[isrHead++%RING_LEN];
+    return 1;
+}
+
+//the peer never answers (no acks are wanted)
+uint8_t txReceiver(uint8_t byte){
+    return 1;
+}
+
+uint8_t rxSender(uint8_t* byte){
+    return 0;
+}
+
+//moves the bytes of a tick on the wire and through the peer FIFO
+void wireTick(){
+    for(uint32_t w=0;w<WIRE_BYTES_PER_TICK;w++){
+        if(driverHead!=driverTail){
+            uint8_t byte=driver[driverHead++%RING_LEN];
+            if((fifoTail-fifoHead)==FIFO_LEN) fifoOverruns++;
+            else fifo[fifoTail++%FIFO_LEN]=byte;
+        }
+        //interrupt routine spread over the tick
+        if(((w+1)*ISR_BYTES_PER_TICK)/WIRE_BYTES_PER_TICK!=(w*ISR_BYTES_PER_TICK)/WIRE_BYTES_PER_TICK && fifoHead!=fifoTail){
+            isr[isrTail++%RING_LEN]=fifo[fifoHead++%FIFO_LEN];
+        }
+    }
+}
+
+void run(uint32_t bytesPerTick, uint32_t burst){
+    serial_line_handle sender;
+    serial_line_handle receiver;
+    sdlInitLine(&sender,txSender,rxSender,40,3);
+    sdlInitLine(&receiver,txReceiver,rxReceiver,40,3);
+
+    driverHead=driverTail=fifoHead=fifoTail=fifoOverruns=isrHead=isrTail=0;
+    tick=0;
+    sdlSetRateLimit(&sender,bytesPerTick,burst);
+
+    uint8_t payload[PAY_LEN];
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    uint32_t sent=0;
+    uint32_t received=0;
+    while(tick<TICKS){
+        tick++;
+        wireTick();
+        while(sdlReceive(&receiver,rxPayload,sizeof(rxPayload))) received++;
+
+        memset(payload,tick%0x70,PAY_LEN);
+        //frames are offered only while the driver queue has space
+        if((driverTail-driverHead)<DRIVER_LEN && sdlSendAsync(&sender,payload,PAY_LEN,0)) sent++;
+    }
+
+    if(bytesPerTick) printf("rate %2u B/tick, burst %3u B:",bytesPerTick,burst);
+    else printf("no pacing:                 ");
+    printf(" %5u frames sent, %5u received (%5.1f%%), goodput %4.0f B per 1000 ticks, %5u bytes lost by FIFO overruns\n",
+           sent,received,sent ? 100.0*received/sent : 0,received*(double)PAY_LEN/(TICKS/1000),fifoOverruns);
+}
+
+int main(){
+    uint32_t rates[][2]={{0,0},{14,48},{12,48},{11,48},{10,48},{12,16},{12,96}};
+    for(uint32_t r=0;r<sizeof(rates)/sizeof(rates[0]);r++) run(rates[r][0],rates[r][1]);
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file pingBench.c
+ * @brief Benchmark of the round trip time measures
+ *
+ * Two lines exchange only periodic echo frames on a simulated wire which
+ * delays every byte by 5 to 8 ticks each way (so the round trip takes 10
+ * to 16 ticks), with the full and with the compact header, counting the
+ * bytes of the echo frames and comparing the statistics of sdlRttStats()
+ * with the simulated delays.
+ *
+ * Build with "make bench" and run as "pingBench [ticks]".
+ *
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WIRE_LEN (1<<16) //power of 2
+#define MIN_DELAY 5
+#define MAX_DELAY 8
+#define PING_PERIOD 10
+
+uint32_t tick;
+
+uint32_t sdlTimeTick(){
+    return tick;
+}
+
+//wire delaying the bytes (never reordering them)
+typedef struct{
+    uint8_t bytes[WIRE_LEN];
+    uint32_t ticks[WIRE_LEN]; //tick the byte arrives
+    uint32_t head, tail;
+    uint32_t last; //arrival tick of the last byte
+    uint32_t sent;
+}wire;
+
+wire wireAB, wireBA;
+uint32_t delay;
+uint32_t ticks=100000;
+
+void wirePut(wire* w, uint8_t byte){
+    uint32_t at=tick+delay;
+    if(at<w->last) at=w->last;
+    w->last=at;
+    w->bytes[w->tail & (WIRE_LEN-1)]=byte;
+    w->ticks[w->tail & (WIRE_LEN-1)]=at;
+    w->tail++;
+    w->sent++;
+}
+
+uint8_t wireGet(wire* w, uint8_t* byte){
+    if(w->head==w->tail || w->ticks[w->head & (WIRE_LEN-1)]>tick) return 0;
+    *byte=w->bytes[w->head & (WIRE_LEN-1)];
+    w->head++;
+    return 1;
+}
+
+uint8_t txA(uint8_t byte){
+    wirePut(&wireAB,byte);
+    return 1;
+}
+
+uint8_t rxA(uint8_t* byte){
+    return wireGet(&wireBA,byte);
+}
+
+uint8_t txB(uint8_t byte){
+    wirePut(&wireBA,byte);
+    return 1;
+}
+
+uint8_t rxB(uint8_t* byte){
+    return wireGet(&wireAB,byte);
+}
+
+//returns 0 if the statistics don't match the simulated delays (the replies
+//are sent by the first scan after the request arrives, so within a tick)
+uint8_t run(uint8_t compact){
+    serial_line_handle lineA;
+    serial_line_handle lineB;
+    sdlInitLine(&lineA,txA,rxA,100,1);
+    sdlInitLine(&lineB,txB,rxB,100,1);
+    sdlSetCompactHeader(&lineA,compact);
+    sdlSetPingPeriod(&lineA,PING_PERIOD);
+
+    wireAB=(wire){0};
+    wireBA=(wire){0};
+    srand(1);
+
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    for(tick=0;tick<ticks;tick++){
+        delay=MIN_DELAY+rand()%(MAX_DELAY-MIN_DELAY+1);
+        sdlReceive(&lineA,rxPayload,sizeof(rxPayload));
+        sdlReceive(&lineB,rxPayload,sizeof(rxPayload));
+    }
+
+    sdl_rtt_stats stats;
+    sdlRttStats(&lineA,&stats);
+    printf("%-8s %6u requests, %6u replies, %5.2f bytes/request, %5.2f bytes/reply, rtt min %u avg %u max %u jitter %u, suggested timeout %u\n",
+           compact ? "compact:" : "full:",stats.requests,stats.replies,(double)wireAB.sent/stats.requests,(double)wireBA.sent/stats.replies,
+           stats.min,stats.avg,stats.max,stats.jitter,sdlRttTimeout(&lineA));
+
+    return stats.replies && stats.min>=2*MIN_DELAY && stats.max<=2*MAX_DELAY+1;
+}
+
+int main(int argc, char** argv){
+    if(argc>1) ticks=atoi(argv[1]);
+
+    uint8_t ok=run(0);
+    ok&=run(1);
+
+    return ok ? 0 : 1;
+}
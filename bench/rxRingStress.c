@@ -0,0 +1,133 @@
+/**
+ * @file rxRingStress.c
+ * @brief Stress test of the lock-free RX ring
+ * 
+ * A producer thread encodes frames on its own line and pushes the bytes on
+ * the RX ring of the receiving line, in chunks of random length and
+ * alternating sdlRxPush() with sdlRxSpan()/sdlRxCommit(), while the main
+ * thread receives them with sdlReceive() and verifies that every frame
+ * arrives once, in order and intact.
+ * 
+ * Build with "make bench" (add -fsanitize=thread to compflags to also run
+ * it under ThreadSanitizer) and run as "rxRingStress [frames]".
+ * 
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sched.h>
+
+#define MIN_PAY_LEN 4 //payload carries the frame number
+#define MAX_PAY_LEN 64
+
+uint64_t nsNow(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000000ull+t.tv_nsec;
+}
+
+uint32_t sdlTimeTick(){
+    return nsNow()/1000000;
+}
+
+serial_line_handle producerLine;
+serial_line_handle consumerLine;
+uint32_t frameNum=1000000;
+
+//bytes of the frame encoded by the producer line
+uint8_t encoded[SDL_LINE_BUFF_LEN(SDL_MAX_PAY_LEN)];
+uint32_t encodedLen;
+
+uint8_t txEncode(uint8_t byte){
+    encoded[encodedLen++]=byte;
+    return 1;
+}
+
+//payload of frame n (the length and the content depend on n)
+uint32_t makePayload(uint32_t n, uint8_t* payload){
+    uint32_t len=MIN_PAY_LEN+(n*7)%(MAX_PAY_LEN-MIN_PAY_LEN+1);
+    for(uint32_t b=0;b<4;b++) payload[b]=(uint8_t)(n>>(8*b));
+    for(uint32_t b=4;b<len;b++) payload[b]=(uint8_t)(n*31+b);
+    return len;
+}
+
+void* producer(void* arg){
+    uint8_t payload[MAX_PAY_LEN];
+    uint32_t seed=1;
+
+    for(uint32_t n=0;n<frameNum;n++){
+        encodedLen=0;
+        sdlSend(&producerLine,payload,makePayload(n,payload),0);
+
+        uint32_t pushed=0;
+        while(pushed<encodedLen){
+            //ring full, letting the consumer run (needed on a single core)
+            uint8_t* span;
+            if(!sdlRxSpan(&consumerLine,&span)){
+                sched_yield();
+                continue;
+            }
+
+            seed=seed*1103515245+12345;
+            uint32_t chunk=1+(seed>>16)%32;
+            if(chunk>(encodedLen-pushed)) chunk=encodedLen-pushed;
+
+            if(seed & 0x80000000){
+                pushed+=sdlRxPush(&consumerLine,&encoded[pushed],chunk);
+            }else{
+                //writing directly inside the ring, like a DMA
+                uint32_t spanLen=sdlRxSpan(&consumerLine,&span);
+                if(spanLen>chunk) spanLen=chunk;
+                for(uint32_t b=0;b<spanLen;b++) span[b]=encoded[pushed+b];
+                sdlRxCommit(&consumerLine,spanLen);
+                pushed+=spanLen;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char** argv){
+    if(argc>1) frameNum=atoi(argv[1]);
+
+    sdlInitLine(&producerLine,txEncode,NULL,10,0);
+    sdlInitLine(&consumerLine,NULL,NULL,10,0);
+
+    pthread_t thread;
+    uint64_t start=nsNow();
+    pthread_create(&thread,NULL,producer,NULL);
+
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    uint8_t expected[MAX_PAY_LEN];
+    uint32_t received=0;
+    uint32_t errors=0;
+    uint64_t bytes=0;
+    while(received<frameNum){
+        uint32_t len=sdlReceive(&consumerLine,rxPayload,sizeof(rxPayload));
+        if(!len){
+            sched_yield();
+            continue;
+        }
+
+        uint32_t expLen=makePayload(received,expected);
+        uint8_t ok=(len==expLen);
+        for(uint32_t b=0;ok && b<len;b++) ok=(rxPayload[b]==expected[b]);
+        if(!ok){
+            errors++;
+            if(errors<=10) printf("frame %u corrupted or out of order\n",received);
+        }
+        received++;
+        bytes+=len;
+    }
+
+    pthread_join(thread,NULL);
+    double sec=(nsNow()-start)/1e9;
+
+    printf("%u frames, %u errors, %.2f Mframes/s (%.1f MB/s of payload)\n",received,errors,received/1e6/sec,bytes/1e6/sec);
+
+    return errors ? 1 : 0;
+}
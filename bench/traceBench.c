@@ -0,0 +1,118 @@
+/**
+ * @file traceBench.c
+ * @brief Benchmark of the frame trace
+ *
+ * Measures the cost of recording an event without frame bytes and of a
+ * frame event capturing 20 bytes (calling the internal functions used by
+ * the library), then sends and receives frames on a traced line and dumps
+ * the ring with sdlTraceDump(), checking the number of records and the
+ * length of the pcap file.
+ *
+ * Build with "make bench" and run as "traceBench [events]".
+ *
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define FRAME_LEN 20
+#define WIRE_LEN 1024
+#define PCAP_HEADER_LEN 24
+#define PCAP_RECORD_HEADER_LEN 16
+#define PSEUDO_HEADER_LEN 8
+#define FULL_HEADER_LEN 4 //code, flags and hash
+
+//internal functions of the library (records are written by the library itself)
+void traceCapture(serial_line_handle* line, circular_buffer_handle* frame);
+void traceEvent(serial_line_handle* line, uint8_t event, uint16_t hash, uint32_t arg);
+
+uint64_t nsNow(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000000ull+t.tv_nsec;
+}
+
+//a counter instead of the clock, so only the recording is measured
+uint32_t tick;
+
+uint32_t sdlTimeTick(){
+    return tick++;
+}
+
+uint32_t eventNum=10000000;
+
+//bytes on the line (each frame is read before the next one)
+uint8_t wire[WIRE_LEN];
+uint32_t wireIn, wireOut;
+
+uint8_t txByte(uint8_t byte){
+    if(wireIn==WIRE_LEN) return 0;
+    wire[wireIn++]=byte;
+    return 1;
+}
+
+uint8_t rxByte(uint8_t* byte){
+    if(wireOut==wireIn) return 0;
+    *byte=wire[wireOut++];
+    return 1;
+}
+
+//counts the bytes of the pcap file
+uint8_t pcapWrite(const uint8_t* buff, uint32_t len, void* ctx){
+    *(uint32_t*)ctx+=len;
+    return 1;
+}
+
+int main(int argc, char** argv){
+    if(argc>1) eventNum=atoi(argv[1]);
+
+    serial_line_handle line;
+    sdlInitLine(&line,txByte,rxByte,10,0);
+
+    //cost of the records
+    uint8_t frameArray[64];
+    uint8_t frameBytes[FRAME_LEN];
+    for(uint32_t b=0;b<FRAME_LEN;b++) frameBytes[b]=(uint8_t)b;
+    circular_buffer_handle frame;
+    cBuffInit(&frame,frameArray,sizeof(frameArray),0);
+    cBuffPush(&frame,frameBytes,FRAME_LEN,1);
+
+    uint64_t start=nsNow();
+    for(uint32_t n=0;n<eventNum;n++) traceEvent(&line,SDL_TRACE_ACK,(uint16_t)n,0);
+    double eventNs=(double)(nsNow()-start)/eventNum;
+
+    start=nsNow();
+    for(uint32_t n=0;n<eventNum;n++){
+        traceCapture(&line,&frame);
+        traceEvent(&line,SDL_TRACE_TX,(uint16_t)n,0);
+    }
+    double frameNs=(double)(nsNow()-start)/eventNum;
+
+    printf("event without frame bytes %.1f ns, frame event (%u bytes captured) %.1f ns\n",eventNs,FRAME_LEN,frameNs);
+
+    //traced frames: a TX and a RX record each, the ring keeps the last ones
+    uint32_t frameNum=SDL_TRACE_LEN;
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    uint32_t errors=0;
+    for(uint32_t n=0;n<frameNum;n++){
+        wireIn=wireOut=0;
+        frameBytes[0]=(uint8_t)n;
+        sdlSend(&line,frameBytes,FRAME_LEN,0);
+        if(sdlReceive(&line,rxPayload,sizeof(rxPayload))!=FRAME_LEN) errors++;
+    }
+
+    uint32_t pcapLen=0;
+    uint32_t records=sdlTraceDump(&line,pcapWrite,&pcapLen);
+    //header and payload of the frames (before the framing), up to SDL_TRACE_SNAP_LEN bytes
+    uint32_t capLen=FULL_HEADER_LEN+FRAME_LEN;
+    if(capLen>SDL_TRACE_SNAP_LEN) capLen=SDL_TRACE_SNAP_LEN;
+    uint32_t expLen=PCAP_HEADER_LEN+SDL_TRACE_LEN*(PCAP_RECORD_HEADER_LEN+PSEUDO_HEADER_LEN+capLen);
+    if(records!=SDL_TRACE_LEN || pcapLen!=expLen) errors++;
+
+    printf("%u frames sent and received, %u records dumped, %u bytes pcap file (%u expected), %u errors\n",
+           frameNum,records,pcapLen,expLen,errors);
+
+    return errors ? 1 : 0;
+}
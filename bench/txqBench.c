@@ -0,0 +1,111 @@
+/**
+ * @file txqBench.c
+ * @brief Contention benchmark of the multi-producer transmission queue
+ * 
+ * 1 to 16 producer threads send frames on the same line, first through the
+ * lock-free queue (sdlEnqueue(), with the main thread draining it with
+ * sdlTxDrain()) and then calling sdlSend() inside a global mutex, which
+ * is what the queue replaces. The line discards the sent bytes.
+ * 
+ * Build with "make bench" and run as "txqBench [framesPerThread]".
+ * 
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define MAX_THREADS 16
+#define PAY_LEN 16
+
+uint64_t nsNow(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000000ull+t.tv_nsec;
+}
+
+uint32_t sdlTimeTick(){
+    return nsNow()/1000000;
+}
+
+serial_line_handle line;
+pthread_mutex_t lineMutex=PTHREAD_MUTEX_INITIALIZER;
+uint32_t framesPerThread=200000;
+_Atomic uint32_t producersDone;
+
+uint8_t txDiscard(uint8_t byte){
+    return 1;
+}
+
+void* queueProducer(void* arg){
+    uint8_t payload[PAY_LEN]={0};
+
+    for(uint32_t n=0;n<framesPerThread;n++){
+        payload[0]=(uint8_t)n;
+        //queue full, letting the drainer run
+        while(!sdlEnqueue(&line,payload,sizeof(payload),0)) sched_yield();
+    }
+    atomic_fetch_add(&producersDone,1);
+
+    return NULL;
+}
+
+void* mutexProducer(void* arg){
+    uint8_t payload[PAY_LEN]={0};
+
+    for(uint32_t n=0;n<framesPerThread;n++){
+        payload[0]=(uint8_t)n;
+        pthread_mutex_lock(&lineMutex);
+        sdlSend(&line,payload,sizeof(payload),0);
+        pthread_mutex_unlock(&lineMutex);
+    }
+
+    return NULL;
+}
+
+//runs the test with the given producers, returns the sent frames per second
+double runTest(uint32_t threads, uint8_t useQueue){
+    pthread_t producers[MAX_THREADS];
+    uint64_t frames=0;
+
+    sdlInitLine(&line,txDiscard,NULL,10,0);
+    atomic_store(&producersDone,0);
+
+    uint64_t start=nsNow();
+    for(uint32_t t=0;t<threads;t++) pthread_create(&producers[t],NULL,useQueue ? queueProducer : mutexProducer,NULL);
+    if(useQueue){
+        //draining until all the producers are done and the queue is empty
+        while(1){
+            uint8_t done=atomic_load(&producersDone)==threads;
+            uint32_t drained=sdlTxDrain(&line);
+            frames+=drained;
+            if(done && !drained) break;
+            if(!drained) sched_yield();
+        }
+    }else{
+        frames=(uint64_t)threads*framesPerThread;
+    }
+    for(uint32_t t=0;t<threads;t++) pthread_join(producers[t],NULL);
+    double sec=(nsNow()-start)/1e9;
+
+    if(frames!=(uint64_t)threads*framesPerThread) printf("lost frames: %llu sent\n",(unsigned long long)frames);
+
+    return frames/sec;
+}
+
+int main(int argc, char** argv){
+    if(argc>1) framesPerThread=atoi(argv[1]);
+
+    printf("unacked %d bytes frames, %u per thread (Mframes/s)\n",PAY_LEN,framesPerThread);
+    printf("threads  queue   mutex\n");
+    for(uint32_t threads=1;threads<=MAX_THREADS;threads*=2){
+        double queue=runTest(threads,1);
+        double mutex=runTest(threads,0);
+        printf("%7u  %5.2f   %5.2f\n",threads,queue/1e6,mutex/1e6);
+    }
+
+    return 0;
+}
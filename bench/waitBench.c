@@ -0,0 +1,94 @@
+/**
+ * @file waitBench.c
+ * @brief Benchmark of the wait hook
+ *
+ * A thread sends frames wanting an ack to a peer thread which reads its
+ * line every 20 ms, so sdlSend() waits about 20 ms for every ack: the
+ * wait is done spinning on the line and then sleeping on a futex (wait
+ * hook), measuring the CPU time used by the waiting thread and the time
+ * between the ack sent by the peer and the return of sdlSend().
+ *
+ * Build with "make bench" and run as "waitBench [frames]".
+ *
+ */
+
+#include "simpleDataLink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PEER_PERIOD_US 20000
+
+uint64_t nsNow(clockid_t clock){
+    struct timespec t;
+    clock_gettime(clock,&t);
+    return (uint64_t)t.tv_sec*1000000000ull+t.tv_nsec;
+}
+
+uint32_t sdlTimeTick(){
+    return nsNow(CLOCK_MONOTONIC)/1000000;
+}
+
+serial_line_handle lineA; //sender, waiting for the acks
+serial_line_handle lineB; //peer
+uint32_t frameNum=50;
+_Atomic uint64_t ackTime; //time the peer sent the last ack
+_Atomic uint8_t stop;
+
+uint8_t txA(uint8_t byte){
+    return sdlRxPush(&lineB,&byte,1);
+}
+
+uint8_t txB(uint8_t byte){
+    return sdlRxPush(&lineA,&byte,1);
+}
+
+void* peer(void* arg){
+    uint8_t rxPayload[SDL_MAX_PAY_LEN];
+    while(!stop){
+        usleep(PEER_PERIOD_US);
+        if(sdlReceive(&lineB,rxPayload,sizeof(rxPayload))) ackTime=nsNow(CLOCK_MONOTONIC);
+    }
+    return NULL;
+}
+
+void run(uint8_t hook){
+    sdlInitLine(&lineA,txA,NULL,200,0);
+    sdlInitLine(&lineB,txB,NULL,200,0);
+    if(hook) sdlSetWaitFunc(&lineA,sdlFutexWait,sdlFutexWake,NULL);
+
+    stop=0;
+    pthread_t thread;
+    pthread_create(&thread,NULL,peer,NULL);
+
+    uint8_t payload[16]={0};
+    uint64_t cpu=0, wall=0, latency=0;
+    uint32_t acked=0;
+    for(uint32_t n=0;n<frameNum;n++){
+        payload[0]=(uint8_t)n;
+        uint64_t cpuStart=nsNow(CLOCK_THREAD_CPUTIME_ID);
+        uint64_t start=nsNow(CLOCK_MONOTONIC);
+        acked+=sdlSend(&lineA,payload,sizeof(payload),1) ? 1 : 0;
+        uint64_t end=nsNow(CLOCK_MONOTONIC);
+        cpu+=nsNow(CLOCK_THREAD_CPUTIME_ID)-cpuStart;
+        wall+=end-start;
+        latency+=end-ackTime;
+    }
+
+    stop=1;
+    pthread_join(thread,NULL);
+
+    printf("%-12s %u/%u acked, %5.2f ms per wait, CPU %5.1f%% of the wait, ack seen %5.1f us after the peer sent it\n",
+           hook ? "futex hook:" : "spinning:",acked,frameNum,wall/1e6/frameNum,100.0*cpu/wall,latency/1e3/frameNum);
+}
+
+int main(int argc, char** argv){
+    if(argc>1) frameNum=atoi(argv[1]);
+
+    run(0);
+    run(1);
+
+    return 0;
+}
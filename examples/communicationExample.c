@@ -163,7 +163,7 @@ int main(){
 	printf("Line 2, receives a second time but ignores thanks to hash\n");
 	printf("Line 2, received (%u)\n",sdlReceive(&line2,(uint8_t*)rxPay,sizeof(rxPay)));
 
-	printf("Line2, now the buffer is empty!\n");
+	printf("Line2, now the buffer only holds the last flag (it can be shared with the next frame)\n");
 	printf("Line2, Rx buffer: "); cBuffPrint(&line2.rxBuff,PRINTBUFF_HEX | PRINTBUFF_NOEMPTY);
 
 	printf("Line 2, start sending %s with ack\n",pay2);
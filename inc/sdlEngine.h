@@ -0,0 +1,209 @@
+/**
+ * @file sdlEngine.h
+ * @brief Multi-line engine for the simple data link protocol
+ *
+ * The engine allows servicing many serial lines from a single thread without
+ * blocking on any of them: lines are processed only when they are signaled
+ * as ready (for example by epoll or by a RX interrupt) and ack timeouts are
+ * kept inside a timer wheel, so the cost of an idle line is zero.
+ * Received frames can be given to the user or forwarded to another line
+ * following a routing table.
+ *
+ * To scale on more cores, use one engine per thread, each one with its own
+ * set of lines (a line must belong to a single engine and routes can only
+ * connect lines of the same engine).
+ *
+ */
+
+#ifndef SDLENGINE_H
+#define SDLENGINE_H
+
+#include "simpleDataLink.h"
+
+#ifndef SDL_ASYNC
+#error "sdlEngine needs the SDL_ASYNC feature enabled in simpleDataLink.h"
+#endif
+
+/**
+ * @brief Macro which defines the maximum number of lines of an engine
+ *
+ * Must be lower than SDL_ENGINE_NO_LINE.
+ *
+ */
+#define SDL_ENGINE_MAX_LINES 256
+
+/**
+ * @brief Macro which defines the number of slots of the timer wheel
+ *
+ * Each slot holds the timers expiring on the same tick (modulo the wheel
+ * length), it should be close to the lines timeout (in sdlTimeTick() units)
+ * to avoid scanning timers that expire on later rounds.
+ *
+ */
+#define SDL_ENGINE_WHEEL_LEN 64
+
+/**
+ * @brief Macro which defines the maximum number of frames received from a
+ *        single line in a service round
+ *
+ * This avoids a very busy line starving the others, if the budget is
+ * exhausted the line stays in the ready list for the next round.
+ *
+ */
+#define SDL_ENGINE_POLL_BUDGET 8
+
+/**
+ * @brief Macro which defines the number of epoll events read at once by
+ *        sdlEngineWaitEpoll()
+ *
+ */
+#define SDL_ENGINE_EPOLL_BATCH 64
+
+/**
+ * @brief Invalid line id (returned on errors and used to remove routes)
+ *
+ */
+#define SDL_ENGINE_NO_LINE 0xFFFF
+
+/**
+ * @brief Engine data associated to each line
+ *
+ * The user should never touch those members.
+ *
+ */
+typedef struct{
+    serial_line_handle* line; ///< Serviced line
+    uint16_t route; ///< Line id where to forward received frames (SDL_ENGINE_NO_LINE if none)
+    uint8_t routeAck; ///< Flag to signal if forwarded frames want an ack
+    uint8_t ready; ///< Flag to signal that the line is inside the ready list
+    uint16_t nextReady; ///< Next line inside the ready list
+    uint8_t timerArmed; ///< Flag to signal that the line is inside the timer wheel
+    uint16_t timerNext; ///< Next line inside the same wheel slot
+    uint16_t timerPrev; ///< Previous line inside the same wheel slot
+    uint32_t deadline; ///< Tick at which the ack timeout expires
+}sdl_engine_slot;
+
+/**
+ * @brief Engine handle
+ *
+ * Must be initialized with sdlEngineInit(), the callbacks are optional
+ * (can be NULL) and have the following meaning:
+ *
+ * rxFunc: called for every received frame which is not routed to another
+ *         line, the payload buffer is valid only during the call
+ * txDoneFunc: called when a frame sent with sdlEngineSend() wanting an ack
+ *             is acknowledged (acked=1) or all the retries failed (acked=0)
+ *
+ */
+typedef struct sdl_engine_handle{
+    sdl_engine_slot slots[SDL_ENGINE_MAX_LINES]; ///< Lines data
+    uint32_t lineNum; ///< Number of lines added
+    uint16_t readyHead; ///< First line of the ready list
+    uint16_t readyTail; ///< Last line of the ready list
+    uint16_t wheel[SDL_ENGINE_WHEEL_LEN]; ///< Timer wheel (first line of each slot)
+    uint32_t wheelTick; ///< Last tick processed by the timer wheel
+    uint32_t dropped; ///< Number of frames which could not be forwarded
+    void (*rxFunc)(struct sdl_engine_handle* engine, uint32_t id, uint8_t* buff, uint32_t len); ///< Reception callback
+    void (*txDoneFunc)(struct sdl_engine_handle* engine, uint32_t id, uint8_t acked); ///< Transmission completed callback
+    uint8_t rxArray[SDL_MAX_PAY_LEN]; ///< Reception array shared by all the lines
+}sdl_engine_handle;
+
+/**
+ * @brief Init engine handle
+ *
+ * @param engine engine handle to be initialized
+ * @param rxFunc reception callback (can be NULL)
+ * @param txDoneFunc transmission completed callback (can be NULL)
+ */
+void sdlEngineInit(sdl_engine_handle* engine, void (*rxFunc)(sdl_engine_handle* engine, uint32_t id, uint8_t* buff, uint32_t len), void (*txDoneFunc)(sdl_engine_handle* engine, uint32_t id, uint8_t acked));
+
+/**
+ * @brief Add a line to the engine
+ *
+ * The line must be already initialized (sdlInitLine() or sdlInitLineArena())
+ * and must not have a reception handler (see sdlSetRxHandler()), the returned id
+ * identifies the line inside the engine (it can be used for example as
+ * epoll user data). The line is initially marked as ready.
+ *
+ * @param engine engine handle
+ * @param line serial line handle to be added
+ * @return uint32_t line id, SDL_ENGINE_NO_LINE in case of error
+ */
+uint32_t sdlEngineAddLine(sdl_engine_handle* engine, serial_line_handle* line);
+
+/**
+ * @brief Set the route of the frames received on a line
+ *
+ * Every frame received on line from is sent on line to, if the frame cannot
+ * be sent (for example an ack is wanted and the destination line is still
+ * waiting for the ack of a previous frame, or the frame is held by the
+ * pacing or by the flow control of the destination line) it's dropped and
+ * counted inside the engine dropped member, frames are never queued.
+ *
+ * @param engine engine handle
+ * @param from id of the line receiving the frames
+ * @param to id of the destination line (SDL_ENGINE_NO_LINE to remove the route)
+ * @param ackWanted flag to signal if forwarded frames want an ack
+ * @return uint8_t 0 in case of error, !0 otherwise
+ */
+uint8_t sdlEngineSetRoute(sdl_engine_handle* engine, uint32_t from, uint32_t to, uint8_t ackWanted);
+
+/**
+ * @brief Signal that a line has new data to be processed
+ *
+ * Should be called when the line I/O is ready (new bytes received), the line
+ * will be processed at the next sdlEngineService() call.
+ *
+ * @param engine engine handle
+ * @param id line id
+ */
+void sdlEngineNotify(sdl_engine_handle* engine, uint32_t id);
+
+/**
+ * @brief Send payload on a line of the engine
+ *
+ * Same as sdlSendAsync(), but the ack timeout is handled by the engine
+ * and the outcome is signaled with the txDoneFunc callback.
+ * NB: like sdlSendAsync(), a frame held by the pacing or by the flow control
+ * is not sent and 0 is returned, the caller has to try again later.
+ *
+ * @param engine engine handle
+ * @param id line id
+ * @param buff array containing the payload
+ * @param len length of the payload (must be <= line maximum payload length)
+ * @param ackWanted flag to signal if we want to receive an ack for this frame
+ * @return uint8_t 0 in case of error (or line busy), !0 otherwise
+ */
+uint8_t sdlEngineSend(sdl_engine_handle* engine, uint32_t id, uint8_t* buff, uint32_t len, uint8_t ackWanted);
+
+/**
+ * @brief Service the engine
+ *
+ * Processes the ready lines (receiving, forwarding and acknowledging frames)
+ * and the expired ack timeouts, it never blocks.
+ *
+ * @param engine engine handle
+ * @return uint32_t number of frames received
+ */
+uint32_t sdlEngineService(sdl_engine_handle* engine);
+
+#ifdef __linux__
+/**
+ * @brief Wait for epoll events and service the engine
+ *
+ * The lines file descriptors must be registered on epfd by the user, with
+ * the line id as epoll user data (data.u32 member), the function waits for
+ * events for at most timeoutMs, notifies the ready lines and then calls
+ * sdlEngineService().
+ * The timeout should not be longer than one sdlTimeTick() unit, in order for
+ * the timer wheel to be serviced on time.
+ *
+ * @param engine engine handle
+ * @param epfd epoll file descriptor
+ * @param timeoutMs maximum wait time in milliseconds (-1 to wait forever)
+ * @return int number of epoll events, -1 in case of error
+ */
+int sdlEngineWaitEpoll(sdl_engine_handle* engine, int epfd, int timeoutMs);
+#endif
+
+#endif
@@ -20,19 +20,60 @@
  */
 typedef struct{
     uint8_t code; ///< frame code (FRMCODE_)
-    uint8_t ackWanted; ///< flag to signal that the frame wants an ack
+    uint8_t ackWanted; ///< frame flags: the frame wants an ack (bit 0), the payload is compressed (bit 1)
     uint16_t hash; ///< frame hash (for acknowledges)
 }__attribute__((packed)) frameHeader;
 
+/**
+ * @brief Integrity check types (see sdlSetCrc())
+ * 
+ */
+#define SDL_CRC16 0 ///< CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF), default
+#define SDL_CRC32 1 ///< CRC-32 (IEEE 802.3)
+#define SDL_CRC32C 2 ///< CRC-32C (Castagnoli), uses the SSE4.2 crc32 instruction if available
+#define SDL_MAX_CRC_LEN 4 ///< Length of the longest CRC
+
+/**
+ * @brief Length of the line buffers needed for a certain payload length
+ * 
+ * This is the length of the longest frame carrying a payload of payLen
+ * bytes (header, payload and CRC all byte stuffed, plus the two flags).
+ * 
+ */
+#define SDL_LINE_BUFF_LEN(payLen) ((sizeof(frameHeader)+(payLen)+SDL_MAX_CRC_LEN)*2+2)
+
 /**
  * @brief Macro which defines the maximum payload length
  * 
  * This corresponds to the maximum length of only the frame payload
- * (frame header and CRC excluded).
+ * (frame header and CRC excluded), lines initialized with
+ * sdlInitLineArena() can use a lower maximum payload length.
  * 
  */
 #define SDL_MAX_PAY_LEN 128
 
+/**
+ * @brief Macro which enables the line buffers embedded inside the handle
+ * 
+ * If this is defined, every line handle embeds its buffers sized for
+ * SDL_MAX_PAY_LEN and can be initialized with sdlInitLine(), otherwise
+ * only sdlInitLineArena() is available and the buffers are taken from
+ * memory given by the user, sized for the maximum payload of each line.
+ * 
+ */
+#define SDL_STATIC_BUFFERS
+
+/**
+ * @brief Macro which defines the maximum number of frames scanned by a
+ *        single receive call
+ * 
+ * Duplicated frames don't end sdlReceive(), sdlReceiveRef() and
+ * sdlDispatch(), this bounds their work when the line buffer is full of
+ * them, the frames left are received by the next call (see sdlRxPending()).
+ * 
+ */
+#define SDL_RX_BUDGET 16
+
 /**
  * @brief Macro which enables anti lock feature and defines its depth
  * 
@@ -41,12 +82,206 @@ typedef struct{
  * inside a temporary queue, this macro defines the depth of this queue),
  * this enables avoiding deadlocks that can verify if both endpoints happen
  * to be waiting for an ack at the same time.
- * NB: this can become memory intensive since it will instantiate another
- * buffer of SDL_MAX_PAY_LEN * SDL_ANTILOCK_DEPTH bytes so enable only if
- * needed.
+ * The queue is made of SDL_ANTILOCK_DEPTH frame descriptors pointing inside
+ * a frame pool of SDL_ANTILOCK_POOL_LEN bytes, it's also used by
+ * sdlReceiveRef() to give frames to the user by reference.
  */
 #define SDL_ANTILOCK_DEPTH 5
 
+#ifdef SDL_ANTILOCK_DEPTH
+/**
+ * @brief Macro which defines the length of the frame pool
+ * 
+ * Frames are stored in the pool one after the other using only their own
+ * length, so deep queues of short frames don't need SDL_MAX_PAY_LEN bytes
+ * per descriptor, the pool must at least hold a SDL_MAX_PAY_LEN frame.
+ * Lines initialized with sdlInitLineArena() scale the pool length by their
+ * maximum payload length (see sdlLineArenaLen()).
+ * 
+ */
+#define SDL_ANTILOCK_POOL_LEN (SDL_ANTILOCK_DEPTH*SDL_MAX_PAY_LEN)
+
+#if SDL_ANTILOCK_POOL_LEN < SDL_MAX_PAY_LEN
+#error "SDL_ANTILOCK_POOL_LEN must hold at least a SDL_MAX_PAY_LEN frame"
+#endif
+#endif
+
+/**
+ * @brief Macro which enables the non blocking (asynchronous) transmission API
+ * 
+ * This macro enables sdlSendAsync(), sdlPoll() and sdlCheckTimeout(), those
+ * allow sending frames which want an ack without blocking the caller inside
+ * sdlSend() for the whole timeout, so that a single thread can service many
+ * lines (see sdlEngine.h).
+ * NB: this adds a buffer of SDL_MAX_PAY_LEN bytes to every line handle, used
+ * to keep a copy of the pending payload for retransmissions.
+ */
+//#define SDL_ASYNC
+
+/**
+ * @brief Macro which enables the lock-free RX ring and defines its length
+ * 
+ * This macro adds to every line a single producer/single consumer ring where
+ * an interrupt routine (or a reader thread) can push received bytes with
+ * sdlRxPush() (or write them directly, for example with a DMA, by using
+ * sdlRxSpan() and sdlRxCommit()) while the main loop receives frames, the
+ * ring is drained inside rxBuff before reading from rxFunc, which can be NULL.
+ * The ring uses C11 atomics so no lock is needed, but only one producer and
+ * one consumer are allowed per line.
+ * NB: the length must be a power of 2.
+ */
+//#define SDL_RX_RING_LEN 256
+
+#ifdef SDL_RX_RING_LEN
+#if (SDL_RX_RING_LEN & (SDL_RX_RING_LEN-1))
+#error "SDL_RX_RING_LEN must be a power of 2"
+#endif
+#endif
+
+/**
+ * @brief Macro which enables the multi-producer transmission queue and
+ *        defines its depth
+ * 
+ * This macro adds to every line a lock-free queue where many threads can
+ * insert payloads with sdlEnqueue() at the same time, the frames are then
+ * encoded and sent back-to-back by a single drainer calling sdlTxDrain(),
+ * so that sdlSend() calls on the same line don't need to be serialized
+ * with a mutex.
+ * NB: this instantiates SDL_TXQ_DEPTH buffers of SDL_MAX_PAY_LEN bytes
+ * and needs the SDL_ASYNC feature, the depth must be a power of 2.
+ */
+//#define SDL_TXQ_DEPTH 8
+
+#ifdef SDL_TXQ_DEPTH
+#if (SDL_TXQ_DEPTH & (SDL_TXQ_DEPTH-1))
+#error "SDL_TXQ_DEPTH must be a power of 2"
+#endif
+#ifndef SDL_ASYNC
+#error "SDL_TXQ_DEPTH needs the SDL_ASYNC feature"
+#endif
+#endif
+
+/**
+ * @brief Macro which enables the batched transmission of the queue and
+ *        defines the burst length
+ * 
+ * With this macro sdlTxDrain() encodes all the queued frames inside a
+ * single burst of SDL_TX_BURST_LEN bytes which is given to the line with
+ * one call of the burst function (see sdlSetTxBurstFunc()), consecutive
+ * frames of the burst share the flag byte between them like in HDLC.
+ * NB: the burst must fit at least the longest frame (2*(header+
+ * SDL_MAX_PAY_LEN+CRC)+2 bytes) and needs the SDL_TXQ_DEPTH feature.
+ */
+//#define SDL_TX_BURST_LEN 1024
+
+#if defined(SDL_TX_BURST_LEN) && !defined(SDL_TXQ_DEPTH)
+#error "SDL_TX_BURST_LEN needs the SDL_TXQ_DEPTH feature"
+#endif
+
+/**
+ * @brief Macro which enables the wait hook of the blocking functions
+ * 
+ * Without this macro sdlSend() spins on the line (and on sdlTimeTick())
+ * for the whole ack timeout, with it the line can be given a wait function
+ * (see sdlSetWaitFunc()) which puts the caller to sleep until new bytes are
+ * signaled with sdlNotify() (for example by the RX interrupt or by the
+ * reader thread, sdlRxCommit() already does it) or the timeout expires.
+ * The wait can be a futex or a condition variable on Linux (sdlFutexWait()
+ * and sdlFutexWake() are provided), a semaphore on an RTOS or a WFI on a
+ * bare metal MCU.
+ */
+//#define SDL_WAIT_HOOK
+
+#if defined(SDL_RX_RING_LEN) || defined(SDL_TXQ_DEPTH) || defined(SDL_WAIT_HOOK)
+#include <stdatomic.h>
+#endif
+
+/**
+ * @brief Macro which enables the payload compression and defines the
+ *        number of bits of its hash table
+ * 
+ * This macro enables sdlSetCompression(), lines with compression enabled
+ * compress the payload of every frame with a small LZ77 codec (LZF-like,
+ * no heap is used) before adding CRC and byte stuffing, frames which don't
+ * shrink are sent uncompressed. Compressed frames are marked in the header
+ * and decompressed on reception, whatever the line setting.
+ * NB: the hash table (2^SDL_COMPRESS_HASH_BITS 16 bit entries) is placed
+ * on the stack of the sending function.
+ */
+//#define SDL_COMPRESS_HASH_BITS 8
+
+/**
+ * @brief Macro which enables the credit based flow control
+ * 
+ * This macro enables sdlSetFlowControl(), without it the lines don't count
+ * the bytes sent and received and data frames are never held for lack of
+ * credits (the credit frames sent by the other endpoint are discarded and
+ * the credits carried by its acks are ignored).
+ */
+//#define SDL_FLOW_CTRL
+
+/**
+ * @brief Macro which enables the transmission pacing
+ * 
+ * This macro enables sdlSetRateLimit(), without it the lines don't keep a
+ * token bucket and data frames are never held to limit the transmission
+ * rate.
+ */
+//#define SDL_PACING
+
+/**
+ * @brief Macro which enables the round trip time measures
+ * 
+ * This macro enables sdlPing(), sdlSetPingPeriod(), sdlRttStats() and
+ * sdlRttTimeout(), without it the echo frames sent by the other endpoint
+ * are discarded without any reply.
+ */
+//#define SDL_PING
+
+/**
+ * @brief Macro which enables the frame trace ring and defines its length
+ * 
+ * This macro adds to every line a ring of SDL_TRACE_LEN records where the
+ * library logs, timestamped with SDL_TRACE_CLOCK(), the frames sent and
+ * decoded, the CRC failures, the matched acks, the retransmissions and the
+ * send timeouts, keeping the first SDL_TRACE_SNAP_LEN bytes of every frame.
+ * Recording an event only fills the next record (no lock is taken, the ring
+ * belongs to the thread using the line) and the ring can be saved as a pcap
+ * file with sdlTraceDump() for offline analysis.
+ * NB: the length must be a power of 2, every record takes
+ * 16+SDL_TRACE_SNAP_LEN bytes.
+ */
+//#define SDL_TRACE_LEN 256
+
+#ifdef SDL_TRACE_LEN
+#if (SDL_TRACE_LEN & (SDL_TRACE_LEN-1))
+#error "SDL_TRACE_LEN must be a power of 2"
+#endif
+
+/**
+ * @brief Number of frame bytes kept by every trace record
+ * 
+ */
+#ifndef SDL_TRACE_SNAP_LEN
+#define SDL_TRACE_SNAP_LEN 32
+#endif
+
+/**
+ * @brief Clock used to timestamp the trace records and length of its unit
+ *        in nanoseconds
+ * 
+ * By default records are timestamped with sdlTimeTick() in milliseconds,
+ * both can be redefined to use a finer clock (for example a cycle counter).
+ * 
+ */
+#ifndef SDL_TRACE_CLOCK
+#define SDL_TRACE_CLOCK() sdlTimeTick()
+#endif
+#ifndef SDL_TRACE_CLOCK_NS
+#define SDL_TRACE_CLOCK_NS 1000000
+#endif
+#endif
+
 /**
  * @brief Macro which enables the ____sdlTestSendCallback() function
  * 
@@ -56,6 +291,89 @@ typedef struct{
  */
 //#define SDL_DEBUG 
 
+/**
+ * @brief Received frame descriptor
+ * 
+ * Describes a frame parked inside the frame pool, it's given to the user by
+ * sdlReceiveRef() and the payload it points to stays valid until the frame
+ * is released with sdlRelease(), it's also used by sdlReceiveBatch() to
+ * describe the frames written inside the user arena.
+ * 
+ */
+typedef struct{
+    uint8_t* data; ///< Payload
+    uint32_t len; ///< Payload length
+    uint32_t timestamp; ///< Tick of reception (sdlTimeTick() units)
+    uint16_t seq; ///< Frame sequence number (hash)
+    uint8_t channel; ///< Frame code
+}sdl_frame_desc;
+
+#ifdef SDL_PING
+/**
+ * @brief Round trip time statistics of a line
+ * 
+ * Measured with echo frames (see sdlPing() and sdlSetPingPeriod()), times
+ * are in sdlTimeTick() units.
+ * 
+ */
+typedef struct{
+    uint32_t requests; ///< Echo requests sent
+    uint32_t replies; ///< Echo replies received
+    uint32_t last; ///< Last round trip time
+    uint32_t min; ///< Minimum round trip time
+    uint32_t max; ///< Maximum round trip time
+    uint32_t avg; ///< Average round trip time
+    uint32_t jitter; ///< Round trip time jitter (RFC 3550 interarrival jitter estimator)
+}sdl_rtt_stats;
+#endif
+
+#ifdef SDL_TRACE_LEN
+/**
+ * @brief Trace events (event member of the trace records)
+ * 
+ */
+#define SDL_TRACE_TX 0 ///< Frame sent
+#define SDL_TRACE_RX 1 ///< Frame decoded (and removed from the line buffer)
+#define SDL_TRACE_CRC 2 ///< Frame discarded by the CRC (or byte stuffing) check
+#define SDL_TRACE_ACK 3 ///< Ack of a sent frame matched
+#define SDL_TRACE_RETRY 4 ///< Frame retransmitted
+#define SDL_TRACE_TIMEOUT 5 ///< Frame not acknowledged after all the retries
+
+/**
+ * @brief Trace record
+ * 
+ * Captured bytes are the frame header and payload (without byte stuffing
+ * and CRC), except for CRC failures where they are the raw bytes read from
+ * the line.
+ * 
+ */
+typedef struct{
+    uint64_t time; ///< Event timestamp (SDL_TRACE_CLOCK() units)
+    uint8_t event; ///< Event (SDL_TRACE_)
+    uint8_t arg; ///< Retry number (retry and timeout events)
+    uint16_t hash; ///< Hash (or sequence number) of the frame
+    uint16_t frameLen; ///< Frame length
+    uint16_t capLen; ///< Number of captured bytes
+    uint8_t cap[SDL_TRACE_SNAP_LEN]; ///< First bytes of the frame
+}sdl_trace_rec;
+#endif
+
+#ifdef SDL_TXQ_DEPTH
+/**
+ * @brief Transmission queue slot
+ * 
+ * The sequence number tells producers and drainer who owns the slot, the
+ * user should never touch those members.
+ * 
+ */
+typedef struct{
+    _Atomic uint32_t seq; ///< Slot sequence number
+    uint32_t len; ///< Payload length
+    uint8_t ackWanted; ///< Flag to signal that the frame wants an ack
+    uint8_t data[SDL_MAX_PAY_LEN]; ///< Payload
+}sdl_txq_slot;
+#endif
+
 /**
  * @brief Struct containing transmission and reception functions of the serial
  *        line and reception buffer
@@ -82,25 +400,127 @@ typedef struct{
  * the user should never touch the handle members again but instead only use
  * sdlSend() and sdlReceive()
  */
-typedef struct{
+typedef struct serial_line_handle{
     uint8_t (*txFunc)(uint8_t byte); ///< TX function pointer
     uint8_t (*rxFunc)(uint8_t* byte); ///< RX function pointer
     circular_buffer_handle rxBuff;   ///< Rx buffer handle
-    uint8_t rxBuffArray[(sizeof(frameHeader)+SDL_MAX_PAY_LEN+2)*2]; ///< Rx buffer memory array
+#ifdef SDL_STATIC_BUFFERS
+    uint8_t rxBuffArray[SDL_LINE_BUFF_LEN(SDL_MAX_PAY_LEN)]; ///< Rx buffer memory array
+#endif
     circular_buffer_handle tmpBuff; ///< Temporary buffer for frame
-    uint8_t tmpBuffArray[(sizeof(frameHeader)+SDL_MAX_PAY_LEN+2)*2]; ///< Temporary buffer for frame array
+#ifdef SDL_STATIC_BUFFERS
+    uint8_t tmpBuffArray[SDL_LINE_BUFF_LEN(SDL_MAX_PAY_LEN)]; ///< Temporary buffer for frame array
+#endif
+    uint8_t tmpShared; ///< Flag to signal that the temporary buffer is shared with other lines
+    uint32_t maxPayLen; ///< Maximum payload length of the line
     uint32_t timeout; ///< Serial line timeout value (same unit of sdlTimeTick())
     uint32_t retries; ///< Number of retries in case of ack not received
     uint16_t lastRxHash; ///< Last frame hash received
+    uint8_t compactHeader; ///< Flag to signal that data frames are sent with the compact header
+    uint8_t crcType; ///< Integrity check of the line frames (SDL_CRC)
+#ifdef SDL_COMPRESS_HASH_BITS
+    uint8_t compress; ///< Flag to signal that payloads are compressed before sending
+#endif
+    uint16_t hashCnt; ///< Counter generating the hashes of the data frames
+    uint8_t txSeq; ///< Last sequence number sent with the compact header
+    uint8_t rxScanMiss; ///< Frame codes not found by the last rxBuff scan (one bit per code)
+    void (*rxHandler)(struct serial_line_handle* line, uint8_t* buff, uint32_t len, void* ctx); ///< Reception handler (NULL if none)
+    void* rxHandlerCtx; ///< User context given to the reception handler
+    uint32_t rxDropped; ///< Number of received frames discarded for lack of space
+#ifdef SDL_FLOW_CTRL
+    uint8_t flowControl; ///< Flag to signal that credit based flow control is enabled
+    uint16_t rxIn; ///< Number of bytes entered inside rxBuff (modulo 2^16)
+    uint16_t rxAdvertised; ///< Last credit limit advertised to the peer
+    uint16_t txSent; ///< Number of bytes sent on the line (modulo 2^16)
+    uint16_t txLimit; ///< Credit limit advertised by the peer (data frames never make txSent go past it)
+    uint8_t txCredited; ///< Flag to signal that the peer advertised at least one credit limit
+    uint8_t txBlocked; ///< Flag to signal that a data frame is held for lack of credits
+    uint32_t txBlockTick; ///< Tick of the last credit probe (or of the last credit received)
+#endif
+#ifdef SDL_PACING
+    uint32_t rateBytes; ///< Token bucket refill in bytes per tick (0 if pacing is disabled)
+    uint32_t rateBurst; ///< Token bucket size in bytes
+    int32_t rateTokens; ///< Bytes which can be sent right away (negative after a frame longer than the bucket)
+    uint32_t rateTick; ///< Tick of the last token bucket refill
+    uint32_t ratePending; ///< Tokens needed by the data frame held by the pacing (0 if none)
+#endif
+#ifdef SDL_PING
+    uint8_t pingSeq; ///< Sequence number of the last echo request sent
+    uint8_t pingRxSeq; ///< Sequence number of the last echo reply received
+    uint32_t pingPeriod; ///< Period of the automatic echo requests (0 if disabled)
+    uint32_t pingLast; ///< Tick of the last automatic echo request
+    sdl_rtt_stats rtt; ///< Round trip time statistics
+    uint64_t rttSum; ///< Sum of the measured round trip times
+    uint32_t rttJitter; ///< Round trip time jitter multiplied by 16
+#endif
 #ifdef SDL_ANTILOCK_DEPTH
-    circular_buffer_handle alockBuff; ///< Anti lock buffer handle
-    uint8_t alockBuffArray[SDL_ANTILOCK_DEPTH*SDL_MAX_PAY_LEN]; ///< Anti lock buffer array
-    circular_buffer_handle alockQueue; ///< Queue for received frames length handle
-    uint8_t alockQueueArray[SDL_ANTILOCK_DEPTH*sizeof(uint32_t)]; ///< Queue for received frames length array
-    ///< TODO: sizeof(uint32_t) is unelegant, should be changed by defining a type for elemNum in bufferUtils.h
+    sdl_frame_desc alockDescs[SDL_ANTILOCK_DEPTH]; ///< Parked frames descriptors (circular queue)
+    uint32_t alockHead; ///< Index of the oldest descriptor
+    uint32_t alockNum; ///< Number of descriptors in use
+    uint32_t alockOut; ///< Number of descriptors given by reference and not yet released
+    uint8_t* alockPool; ///< Frame pool
+    uint32_t alockPoolLen; ///< Frame pool length
+    uint32_t alockPoolTail; ///< Frame pool offset after the newest frame
+#ifdef SDL_STATIC_BUFFERS
+    uint8_t alockPoolArray[SDL_ANTILOCK_POOL_LEN]; ///< Frame pool array
+#endif
+#endif
+#ifdef SDL_RX_RING_LEN
+    _Atomic uint32_t rxRingHead; ///< RX ring write index (written only by the producer)
+    _Atomic uint32_t rxRingTail; ///< RX ring read index (written only by the consumer)
+    uint8_t rxRingArray[SDL_RX_RING_LEN]; ///< RX ring memory array
+#endif
+#ifdef SDL_WAIT_HOOK
+    void (*waitFunc)(struct serial_line_handle* line, uint32_t seq, uint32_t ticks, void* ctx); ///< Wait function pointer (NULL to spin)
+    void (*wakeFunc)(struct serial_line_handle* line, void* ctx); ///< Wake function pointer (NULL if none)
+    void* waitCtx; ///< User context given to the wait and wake functions
+    _Atomic uint32_t wakeSeq; ///< Wake sequence number (incremented by sdlNotify())
+    _Atomic uint32_t wakeWaiting; ///< Flag to signal that a thread is inside the wait function
+#endif
+#ifdef SDL_TRACE_LEN
+    uint32_t traceHead; ///< Number of trace records written
+    uint32_t traceCrcIndx; ///< rxBuff index of the last frame failing the CRC (logged once)
+    uint32_t traceCrcLen; ///< Length of the last frame failing the CRC
+    sdl_trace_rec traceRing[SDL_TRACE_LEN]; ///< Trace records
+    sdl_trace_rec traceScratch; ///< Bytes captured for the next frame event (copied in the ring with the event)
+#endif
+#ifdef SDL_TXQ_DEPTH
+    _Atomic uint32_t txqTail; ///< Transmission queue insertion index (shared by producers)
+    uint32_t txqHead; ///< Transmission queue extraction index (drainer only)
+    sdl_txq_slot txqSlots[SDL_TXQ_DEPTH]; ///< Transmission queue slots
+#endif
+#ifdef SDL_TX_BURST_LEN
+    uint32_t (*txBurstFunc)(uint8_t* buff, uint32_t len); ///< TX burst function pointer
+    uint8_t txBurstArray[SDL_TX_BURST_LEN]; ///< TX burst memory array
+#ifdef SDL_TRACE_LEN
+    uint32_t traceBurstNum; ///< Number of frames inside the TX burst
+    sdl_trace_rec traceBurst[SDL_TXQ_DEPTH]; ///< Trace records of the TX burst frames (logged once it's written)
+#endif
+#endif
+#ifdef SDL_ASYNC
+    uint8_t txState; ///< State of the asynchronous transmission (SDL_TX_)
+    uint16_t txHash; ///< Hash of the pending frame
+    uint32_t txRetry; ///< Number of retries already done for the pending frame
+    uint32_t txStart; ///< Tick of the last transmission of the pending frame (moved forward while it's held)
+    uint32_t txLen; ///< Length of the pending payload
+    uint8_t* txPay; ///< Copy of the pending payload (for retransmissions)
+#ifdef SDL_STATIC_BUFFERS
+    uint8_t txPayArray[SDL_MAX_PAY_LEN]; ///< Pending payload array
+#endif
 #endif
 }serial_line_handle;
 
+#ifdef SDL_ASYNC
+/**
+ * @brief Asynchronous transmission states (returned by sdlTxState())
+ * 
+ */
+#define SDL_TX_IDLE 0 ///< No frame was sent asynchronously on the line
+#define SDL_TX_WAIT_ACK 1 ///< A frame is waiting for its ack
+#define SDL_TX_ACKED 2 ///< The last frame was acknowledged
+#define SDL_TX_FAILED 3 ///< The last frame was not acknowledged after all the retries
+#endif
+
 /**
  * @brief Get the current tick time (should be defined by user)
  * 
@@ -121,7 +541,8 @@ uint32_t sdlTimeTick();
  * NB: txFunc and rxFunc can also be NULL if the serial line should work only
  * on TX or RX mode, in that case sdlSend() and sdlReceive() simply won't work,
  * obviously in that case you won't be able to transmit frames which need an
- * acknowledge.
+ * acknowledge. If the RX ring is enabled (SDL_RX_RING_LEN), rxFunc can be
+ * NULL and the line will receive only the bytes pushed on the ring.
  * See serial_line_handle documentation above for the format needed by those
  * functions.
  * 
@@ -133,7 +554,45 @@ uint32_t sdlTimeTick();
  *                (the first transmission is not counted, so 0 meaning a single
  *                transmission try)
  */
+#ifdef SDL_STATIC_BUFFERS
 void sdlInitLine(serial_line_handle* line, uint8_t (*txFunc)(uint8_t byte), uint8_t (*rxFunc)(uint8_t* byte), uint32_t timeout, uint32_t retries);
+#endif
+
+/**
+ * @brief Get the memory needed by a line initialized with sdlInitLineArena()
+ * 
+ * @param maxPayLen maximum payload length of the line
+ * @param sharedTmp flag to signal that the line will use a shared temporary
+ *                  buffer (not taken from the arena)
+ * @return uint32_t number of bytes the line takes from the arena
+ */
+uint32_t sdlLineArenaLen(uint32_t maxPayLen, uint8_t sharedTmp);
+
+/**
+ * @brief Init serial line handle with buffers taken from user memory
+ * 
+ * Same as sdlInitLine(), but the line buffers are sized for a maximum
+ * payload of maxPayLen bytes (instead of SDL_MAX_PAY_LEN) and are taken
+ * from the arena given by the user, which must be at least
+ * sdlLineArenaLen() bytes long, this allows lines with very different
+ * payload lengths to pay only for their own needs.
+ * Lines serviced by the same thread can also share a single temporary
+ * buffer (used to encode and decode frames), which must be at least
+ * SDL_LINE_BUFF_LEN() of the largest maximum payload among those lines.
+ * NB: the arena and the shared buffer must stay valid while the line is used.
+ * 
+ * @param line serial line handle to be initialized
+ * @param txFunc tx function pointer 
+ * @param rxFunc rx function pointer
+ * @param timeout serial line timeout period
+ * @param retries number of retries the transmission will make if no ack receved
+ * @param maxPayLen maximum payload length of the line (must be <= SDL_MAX_PAY_LEN)
+ * @param arena memory where the line buffers will be placed
+ * @param arenaLen length of the arena
+ * @param sharedTmp shared temporary buffer (NULL to take it from the arena)
+ * @return uint32_t number of bytes taken from the arena, 0 in case of error
+ */
+uint32_t sdlInitLineArena(serial_line_handle* line, uint8_t (*txFunc)(uint8_t byte), uint8_t (*rxFunc)(uint8_t* byte), uint32_t timeout, uint32_t retries, uint32_t maxPayLen, uint8_t* arena, uint32_t arenaLen, uint8_t* sharedTmp);
 
 /**
  * @brief Send payload through serial line
@@ -142,11 +601,12 @@ void sdlInitLine(serial_line_handle* line, uint8_t (*txFunc)(uint8_t byte), uint
  * The function needs a serial line handler, a buffer containing the payload
  * and the lenght of the latter.
  * NB: The function will return error if the length len is higher than the
- * maximum allowed payload length, defined as the SDL_MAX_PAY_LEN macro.
+ * maximum allowed payload length of the line, defined as the SDL_MAX_PAY_LEN
+ * macro or given to sdlInitLineArena().
  * 
  * @param line serial line handle where to send
  * @param buff array containing the payload
- * @param len length of the payload (must be <= SDL_MAX_PAY_LEN)
+ * @param len length of the payload (must be <= line maximum payload length)
  * @param ackWanted flag to signal if we want to receive an ack for this frame
  * @return uint8_t 0 in case of error, !0 otherwise
  */
@@ -164,7 +624,14 @@ uint8_t sdlSend(serial_line_handle* line, uint8_t* buff, uint32_t len, uint8_t a
  * than SDL_MAX_PAY_LEN macro but it's recommended to at least provide a len
  * of SDL_MAX_PAY_LEN in order to not miss any payload.
  * The function will not return received payloads that are higher than
- * the len argument or SDL_MAX_PAY_LEN.
+ * the len argument or SDL_MAX_PAY_LEN, those are discarded (without ack),
+ * counted in the line rxDropped member and end the call, which returns 0:
+ * a rxDropped increased by a call returning 0 signals a too short buff.
+ * Duplicated frames (retransmissions of a frame already received) are
+ * acknowledged again and skipped, so 0 means that no new frame was found
+ * (or that SDL_RX_BUDGET frames were skipped, see sdlRxPending()).
+ * If some frames were taken by reference with sdlReceiveRef(), they must
+ * be released before calling this function (0 is returned otherwise).
  * 
  * @param line serial line handle where to receive
  * @param buff array where the payload will be written
@@ -173,6 +640,510 @@ uint8_t sdlSend(serial_line_handle* line, uint8_t* buff, uint32_t len, uint8_t a
  */
 uint32_t sdlReceive(serial_line_handle* line, uint8_t* buff, uint32_t len);
 
+#ifdef SDL_ANTILOCK_DEPTH
+/**
+ * @brief Receive a frame by reference
+ * 
+ * Gives the oldest parked frame not already taken (or receives a fresh one
+ * inside the frame pool) without copying its payload, the descriptor data
+ * stays valid until the frame is released with sdlRelease(). More frames
+ * can be taken before releasing them, up to SDL_ANTILOCK_DEPTH or until the
+ * pool is full.
+ * NB: not available for lines with a reception handler.
+ * 
+ * @param line serial line handle where to receive
+ * @param desc descriptor where the frame informations will be written
+ * @return uint32_t length of the received payload, 0 if no payload or error
+ */
+uint32_t sdlReceiveRef(serial_line_handle* line, sdl_frame_desc* desc);
+
+/**
+ * @brief Release a frame taken with sdlReceiveRef()
+ * 
+ * Frames are released in the same order they were taken, the oldest one is
+ * released and its pool space can be reused.
+ * 
+ * @param line serial line handle
+ * @return uint8_t 0 if there was no frame to be released, !0 otherwise
+ */
+uint8_t sdlRelease(serial_line_handle* line);
+#endif
+
+/**
+ * @brief Receive all the available frames of a line in one call
+ *
+ * Decodes every complete data frame inside the reception buffer with a
+ * single scan (sdlReceive() scans the buffer again for every frame), the
+ * payloads are written one after the other inside arena and described by
+ * descs, the acks of the frames which want one are sent together at the
+ * end of the scan. Frames parked inside the anti-lock queue are given first.
+ * The scan stops when descs are full or when the arena space left is lower
+ * than the line maximum payload length, the remaining frames are received
+ * by the next call.
+ * NB: not available if the line has a reception handler (see sdlDispatch()).
+ *
+ * @param line serial line handle where to receive
+ * @param descs array where the frame descriptors are written
+ * @param maxDescs number of descriptors inside descs
+ * @param arena array where the payloads are written
+ * @param arenaLen length of arena
+ * @return uint32_t number of frames received (descriptors written)
+ */
+uint32_t sdlReceiveBatch(serial_line_handle* line, sdl_frame_desc* descs, uint32_t maxDescs, uint8_t* arena, uint32_t arenaLen);
+
+/**
+ * @brief Select the integrity check of a line
+ * 
+ * Frames are protected by default with a CRC-16, which is enough for short
+ * frames, for longer frames a CRC-32 or CRC-32C (which is computed with the
+ * SSE4.2 crc32 instruction if the CPU has it) gives a stronger detection.
+ * NB: both endpoints of the line must use the same integrity check, frames
+ * with a different one are discarded.
+ * 
+ * @param line serial line handle
+ * @param crcType integrity check type (SDL_CRC16, SDL_CRC32 or SDL_CRC32C)
+ * @return uint8_t 0 in case of error, !0 otherwise
+ */
+uint8_t sdlSetCrc(serial_line_handle* line, uint8_t crcType);
+
+#ifdef SDL_COMPRESS_HASH_BITS
+/**
+ * @brief Enable the payload compression on a line
+ * 
+ * Payloads are compressed before being sent, and go out uncompressed if
+ * the compression doesn't shrink them (for example already compressed or
+ * random data), this trades CPU time for less bytes on the line.
+ * NB: the other endpoint must have the SDL_COMPRESS_HASH_BITS feature
+ * enabled, otherwise compressed frames are discarded.
+ * 
+ * @param line serial line handle
+ * @param compress !0 to compress payloads, 0 to send them as they are (default)
+ */
+void sdlSetCompression(serial_line_handle* line, uint8_t compress);
+#endif
+
+/**
+ * @brief Select the header profile of the frames sent on a line
+ * 
+ * The compact header takes 2 bytes instead of 4: the frame code (5 bits) and
+ * the ack wanted flag are packed in the first byte, together with a marker
+ * bit, and the 16 bit hash is replaced by an 8 bit sequence number counted
+ * per line, this reduces the overhead of very short payloads.
+ * Receivers always detect the profile of every frame, and acks are sent back
+ * with the same profile of the acknowledged frame, so the profile only needs
+ * to be selected on the transmitting side, but the other endpoint must be
+ * able to decode compact headers: older versions of the library never ack
+ * them nor remove them from the reception buffer, which fills up with them.
+ * NB: should only be changed while no frame is waiting for an ack.
+ * 
+ * @param line serial line handle
+ * @param compact !0 to send compact headers, 0 to send full headers (default)
+ */
+void sdlSetCompactHeader(serial_line_handle* line, uint8_t compact);
+
+#ifdef SDL_FLOW_CTRL
+/**
+ * @brief Enable the credit based flow control on a line
+ *
+ * The receiving side advertises how many bytes it can still accept (the free
+ * space of its rxBuff) inside its acks and inside small credit frames sent
+ * when the user frees enough space by reading frames, the sending side holds
+ * data frames which don't fit in the advertised window instead of sending
+ * them to be lost, so a slow consumer slows down the sender without drops
+ * and retransmissions. Acks and control frames are never held.
+ * While a frame is held, sdlSend() waits for new credits (without counting
+ * it as a retry) and sdlSendAsync() returns 0, if no credit arrives within
+ * the line timeout the sender probes the receiver, which answers with its
+ * current window (this also recovers from credit frames lost on the line).
+ * NB: must be enabled on both endpoints before any frame is exchanged, and
+ * the driver (or the RX ring) must be able to hold a whole rxBuff worth of
+ * bytes between two receive calls.
+ *
+ * @param line serial line handle
+ * @param enable !0 to enable the flow control, 0 to disable it (default)
+ */
+void sdlSetFlowControl(serial_line_handle* line, uint8_t enable);
+#endif
+
+#ifdef SDL_PACING
+/**
+ * @brief Set the transmission rate limit of a line
+ *
+ * Frames are paced by a token bucket which is refilled with bytesPerTick
+ * bytes every sdlTimeTick() unit up to burst bytes, every byte sent on the
+ * line takes a token, so the other endpoint never receives more than burst
+ * bytes back-to-back and no more than bytesPerTick bytes per tick on the
+ * long run (acks and control frames take tokens too, but are never held).
+ * A data frame is sent only if the bucket holds its length in tokens (or is
+ * full, for frames longer than the bucket), otherwise sdlSend() waits for
+ * the tokens, while sdlSendAsync(), sdlCheckTimeout() and sdlTxDrain() return
+ * leaving the frame to the next call, so other lines serviced by the same
+ * thread are not blocked.
+ * The burst should not be longer than the receiving FIFO of the other
+ * endpoint, and the tick short enough for the rate to be an integer number
+ * of bytes.
+ *
+ * @param line serial line handle
+ * @param bytesPerTick bytes allowed per sdlTimeTick() unit (0 to disable the pacing, default)
+ * @param burst token bucket size in bytes (must be !0 if the pacing is enabled)
+ * @return uint8_t 0 in case of error, !0 otherwise
+ */
+uint8_t sdlSetRateLimit(serial_line_handle* line, uint32_t bytesPerTick, uint32_t burst);
+#endif
+
+#ifdef SDL_PING
+/**
+ * @brief Measure the round trip time of a line
+ * 
+ * Sends an echo request, which the other endpoint answers as soon as any of
+ * its receive functions scans the line, and waits for the reply for at most
+ * the line timeout (receiving frames in the anti-lock queue meanwhile).
+ * Echo frames don't travel on the data channel, are never held by the flow
+ * control or by the pacing and the measure is added to the line statistics.
+ * NB: both endpoints must define SDL_PING (without it the requests are
+ * discarded without a reply), older versions of the library never remove
+ * echo frames from the reception buffer, which fills up with them.
+ * 
+ * @param line serial line handle
+ * @param rtt where to write the round trip time in sdlTimeTick() units (can be NULL)
+ * @return uint8_t 0 in case of error (or no reply within the timeout), !0 otherwise
+ */
+uint8_t sdlPing(serial_line_handle* line, uint32_t* rtt);
+
+/**
+ * @brief Set the period of the automatic echo requests of a line
+ * 
+ * Once set, an echo request is sent every period ticks by sdlReceive() (and
+ * so by sdlPoll()) or sdlDispatch(), without waiting for the reply, replies
+ * are collected by any receive function and update the line statistics.
+ * 
+ * @param line serial line handle
+ * @param period period in sdlTimeTick() units (0 to disable, default)
+ */
+void sdlSetPingPeriod(serial_line_handle* line, uint32_t period);
+
+/**
+ * @brief Get the round trip time statistics of a line
+ * 
+ * @param line serial line handle
+ * @param stats where to write the statistics
+ * @return uint8_t 0 in case of error, !0 otherwise
+ */
+uint8_t sdlRttStats(serial_line_handle* line, sdl_rtt_stats* stats);
+
+/**
+ * @brief Get an ack timeout suggested by the measured round trip times
+ * 
+ * The timeout is the average round trip time plus four times the jitter,
+ * but never less than the maximum round trip time measured (plus one tick
+ * for the counter resolution), it can be given back to the line by the user.
+ * It only covers the link, so the time the other endpoint needs to read data
+ * frames (which are acknowledged when read) must be added.
+ * 
+ * @param line serial line handle
+ * @return uint32_t suggested timeout in sdlTimeTick() units, 0 if no echo reply was received
+ */
+uint32_t sdlRttTimeout(serial_line_handle* line);
+#endif
+
+/**
+ * @brief Set the reception handler of a line
+ * 
+ * Once a handler is set, every data frame received on the line is given to
+ * it as soon as it's deframed, whatever function received it: sdlDispatch(),
+ * sdlReceive(), sdlPoll() or sdlSend() while waiting for an ack (in this
+ * case the anti-lock queue is not used), those functions will then return
+ * the length of the frame without writing anything in their buffer.
+ * The handler has the following format:
+ * 
+ * line argument: the line where the frame was received
+ * buff argument: payload of the frame, valid only during the call
+ * len argument: length of the payload
+ * ctx argument: user context given to sdlSetRxHandler()
+ * 
+ * NB: the handler is called before sending the ack and the payload may
+ * point inside the line temporary buffer, so the handler must not send
+ * frames on the same line (it can send on other lines, on lines sharing
+ * the temporary buffer the payload is copied on the stack before the call).
+ * 
+ * @param line serial line handle
+ * @param rxHandler reception handler (NULL to go back to the polling mode)
+ * @param ctx user context given to the handler
+ */
+void sdlSetRxHandler(serial_line_handle* line, void (*rxHandler)(serial_line_handle* line, uint8_t* buff, uint32_t len, void* ctx), void* ctx);
+
+/**
+ * @brief Receive all the available frames, giving them to the line handler
+ * 
+ * This function reads the new bytes from the line (rxFunc or RX ring) and
+ * calls the reception handler for every complete frame found, if no new
+ * byte arrived since the last call the reception buffer is not scanned
+ * again, so calling it on an idle line is cheap. At most SDL_RX_BUDGET
+ * frames are scanned, duplicated ones included.
+ * 
+ * @param line serial line handle (must have a reception handler)
+ * @return uint32_t number of frames given to the handler
+ */
+uint32_t sdlDispatch(serial_line_handle* line);
+
+/**
+ * @brief Check if the last receive call left frames to be scanned
+ * 
+ * A receive call which returns 0 after exhausting SDL_RX_BUDGET or after
+ * discarding a frame too long for its buffer hasn't scanned the whole line
+ * buffer, the remaining frames are found by calling it again even if no
+ * new byte arrives.
+ * 
+ * @param line serial line handle
+ * @return uint8_t !0 if the line buffer may hold other frames, 0 otherwise
+ */
+uint8_t sdlRxPending(serial_line_handle* line);
+
+#ifdef SDL_RX_RING_LEN
+/**
+ * @brief Push received bytes on the line RX ring (producer side)
+ * 
+ * This function can be called from an interrupt routine or from a thread
+ * different from the one calling the receive functions, but only from one
+ * producer at a time for each line.
+ * 
+ * @param line serial line handle where the bytes were received
+ * @param data array containing the received bytes
+ * @param len number of received bytes
+ * @return uint32_t number of bytes pushed (lower than len if the ring is full)
+ */
+uint32_t sdlRxPush(serial_line_handle* line, const uint8_t* data, uint32_t len);
+
+/**
+ * @brief Get the free contiguous span of the line RX ring (producer side)
+ * 
+ * This allows the producer (for example a DMA) to write the received bytes
+ * directly inside the ring, the written bytes must then be published with
+ * sdlRxCommit(). Same concurrency rules of sdlRxPush() apply.
+ * 
+ * @param line serial line handle
+ * @param span pointer where the span start address will be written
+ * @return uint32_t length of the span (0 if the ring is full)
+ */
+uint32_t sdlRxSpan(serial_line_handle* line, uint8_t** span);
+
+/**
+ * @brief Publish bytes written inside the span given by sdlRxSpan()
+ * 
+ * @param line serial line handle
+ * @param len number of bytes written (must be <= span length)
+ */
+void sdlRxCommit(serial_line_handle* line, uint32_t len);
+#endif
+
+#ifdef SDL_WAIT_HOOK
+/**
+ * @brief Set the wait and wake functions of a line
+ * 
+ * The wait function is called by the blocking functions (sdlSend(), sdlPing()
+ * and the waits for credits or tokens) when there is nothing to do on the line,
+ * it should sleep until the wake function is called or ticks sdlTimeTick()
+ * units have elapsed (returning early is always allowed), and have the
+ * following format:
+ * 
+ * line argument: line which is waiting
+ * seq argument: wake sequence number seen before checking the line, if
+ *               the line wakeSeq member differs the function must not sleep
+ * ticks argument: maximum wait time (in sdlTimeTick() units)
+ * ctx argument: user context given to sdlSetWaitFunc()
+ * 
+ * The wake function is called by sdlNotify() only if a thread is sleeping
+ * inside the wait function, it can be NULL if the wait doesn't need to be
+ * woken up explicitly (for example a WFI woken by the RX interrupt itself).
+ * 
+ * @param line serial line handle
+ * @param waitFunc wait function pointer (NULL to go back to spinning)
+ * @param wakeFunc wake function pointer (can be NULL)
+ * @param ctx user context given to the functions
+ */
+void sdlSetWaitFunc(serial_line_handle* line, void (*waitFunc)(serial_line_handle* line, uint32_t seq, uint32_t ticks, void* ctx), void (*wakeFunc)(serial_line_handle* line, void* ctx), void* ctx);
+
+/**
+ * @brief Signal that new bytes (or acks) arrived on a line
+ * 
+ * Wakes up the thread waiting inside a blocking function of the line, it
+ * can be called from an interrupt routine or from another thread, calling
+ * it when nobody is waiting costs only an atomic increment.
+ * 
+ * @param line serial line handle
+ */
+void sdlNotify(serial_line_handle* line);
+
+#ifdef __linux__
+/**
+ * @brief Length of a sdlTimeTick() unit in nanoseconds (used by sdlFutexWait())
+ * 
+ */
+#ifndef SDL_FUTEX_TICK_NS
+#define SDL_FUTEX_TICK_NS 1000000
+#endif
+
+/**
+ * @brief Futex based wait function (Linux only)
+ * 
+ * To be given to sdlSetWaitFunc() together with sdlFutexWake(), sleeps on
+ * the line wakeSeq member, ctx is not used.
+ * 
+ * @param line serial line handle
+ * @param seq wake sequence number seen before checking the line
+ * @param ticks maximum wait time (in sdlTimeTick() units)
+ * @param ctx not used
+ */
+void sdlFutexWait(serial_line_handle* line, uint32_t seq, uint32_t ticks, void* ctx);
+
+/**
+ * @brief Futex based wake function (Linux only)
+ * 
+ * @param line serial line handle
+ * @param ctx not used
+ */
+void sdlFutexWake(serial_line_handle* line, void* ctx);
+#endif
+#endif
+
+#ifdef SDL_TXQ_DEPTH
+/**
+ * @brief Insert payload inside the line transmission queue
+ * 
+ * This function is thread safe and lock-free, it can be called by many
+ * threads at the same time on the same line, the payload is copied inside
+ * the queue and will be sent by the next sdlTxDrain() call.
+ * 
+ * @param line serial line handle where to send
+ * @param buff array containing the payload
+ * @param len length of the payload (must be <= line maximum payload length)
+ * @param ackWanted flag to signal if we want to receive an ack for this frame
+ * @return uint8_t 0 in case of error (or queue full), !0 otherwise
+ */
+uint8_t sdlEnqueue(serial_line_handle* line, uint8_t* buff, uint32_t len, uint8_t ackWanted);
+
+/**
+ * @brief Send the frames inside the line transmission queue
+ * 
+ * Frames are encoded and sent back-to-back with sdlSendAsync(), draining
+ * stops when the queue is empty, when the line cannot send or when a frame
+ * wants an ack and the line is still waiting for the previous one (acks
+ * are collected by sdlPoll() as usual).
+ * NB: only one thread at a time can drain a line, and it must be the same
+ * thread receiving on it, since the two share the line temporary buffer.
+ * 
+ * @param line serial line handle
+ * @return uint32_t number of frames sent
+ */
+uint32_t sdlTxDrain(serial_line_handle* line);
+#endif
+
+#ifdef SDL_TX_BURST_LEN
+/**
+ * @brief Set the burst transmission function of a line
+ * 
+ * The burst function allows sdlTxDrain() to give all the encoded frames to
+ * the driver with a single call (for example a single write() system call),
+ * it must be NON BLOCKING and have the following format:
+ * 
+ * buff argument: array containing the bytes to be sent
+ * len argument: number of bytes to be sent
+ * return: number of bytes actually sent
+ * 
+ * If no burst function is set (NULL), the burst is sent byte by byte with
+ * the line txFunc.
+ * 
+ * @param line serial line handle
+ * @param txBurstFunc burst function pointer (can be NULL)
+ */
+void sdlSetTxBurstFunc(serial_line_handle* line, uint32_t (*txBurstFunc)(uint8_t* buff, uint32_t len));
+#endif
+
+#ifdef SDL_ASYNC
+/**
+ * @brief Send payload through serial line without waiting for the ack
+ * 
+ * Non blocking version of sdlSend(), the frame is sent immediately and,
+ * if an ack is wanted, the payload is copied inside the line handle and
+ * the line enters the SDL_TX_WAIT_ACK state, from that point the ack is
+ * collected by sdlPoll() and the retransmissions are performed by
+ * sdlCheckTimeout(), the outcome can be read with sdlTxState().
+ * Only one frame at a time can wait for an ack on a line, so the function
+ * fails if an ack is wanted and the line is still in the SDL_TX_WAIT_ACK
+ * state (frames without ack can always be sent).
+ * NB: don't mix sdlSend() and sdlSendAsync() calls on the same line while
+ * a frame is pending, sdlSend() would consume its ack.
+ * 
+ * @param line serial line handle where to send
+ * @param buff array containing the payload
+ * @param len length of the payload (must be <= line maximum payload length)
+ * @param ackWanted flag to signal if we want to receive an ack for this frame
+ * @return uint8_t 0 in case of error (or line busy), !0 otherwise
+ */
+uint8_t sdlSendAsync(serial_line_handle* line, uint8_t* buff, uint32_t len, uint8_t ackWanted);
+
+/**
+ * @brief Poll serial line without blocking
+ * 
+ * This function collects the ack of the pending asynchronous frame (if any)
+ * and then behaves exactly like sdlReceive().
+ * 
+ * @param line serial line handle where to receive
+ * @param buff array where the payload will be written
+ * @param len length of the array
+ * @return uint32_t length of the received payload, 0 if no payload or error
+ */
+uint32_t sdlPoll(serial_line_handle* line, uint8_t* buff, uint32_t len);
+
+/**
+ * @brief Check the ack timeout of the pending asynchronous frame
+ * 
+ * If the line is waiting for an ack and the timeout expired, the frame is
+ * sent again, or the line goes in the SDL_TX_FAILED state if all the retries
+ * have already been done.
+ * If the retransmission is held by the pacing (or by the flow control) the
+ * timeout is moved to the tick the frame can be sent (the next tick while
+ * waiting for credits), without counting it as a retry.
+ * 
+ * @param line serial line handle to be checked
+ * @return uint8_t transmission state after the check (SDL_TX_)
+ */
+uint8_t sdlCheckTimeout(serial_line_handle* line);
+
+/**
+ * @brief Get the asynchronous transmission state of a line
+ * 
+ * @param line serial line handle
+ * @return uint8_t transmission state (SDL_TX_)
+ */
+uint8_t sdlTxState(serial_line_handle* line);
+#endif
+
+#ifdef SDL_TRACE_LEN
+/**
+ * @brief Write the line trace ring as a pcap file
+ * 
+ * The records are written from the oldest to the newest with nanosecond
+ * timestamps and link type LINKTYPE_USER0 (147), every packet starts with
+ * an 8 bytes pseudo-header (event, retry number, 16 bit hash and 32 bit
+ * frame length, network ordered) followed by the captured frame bytes.
+ * The write function is called once for the file header and once for every
+ * record, it has the following format:
+ * 
+ * buff argument: bytes to be written
+ * len argument: number of bytes to be written
+ * ctx argument: user context given to sdlTraceDump()
+ * return: 0 in case of error, !0 otherwise
+ * 
+ * NB: must be called by the thread using the line (or while the line is idle).
+ * 
+ * @param line serial line handle
+ * @param writeFunc write function pointer
+ * @param ctx user context given to the write function
+ * @return uint32_t number of records written
+ */
+uint32_t sdlTraceDump(serial_line_handle* line, uint8_t (*writeFunc)(const uint8_t* buff, uint32_t len, void* ctx), void* ctx);
+#endif
 
 /**
  * @brief Callback called between transmission and ack wait
@@ -0,0 +1,239 @@
+/**
+ * @file sdlEngine.c
+ *
+ */
+
+#include "simpleDataLink.h"
+
+//the engine is built only with the non blocking API
+#ifdef SDL_ASYNC
+#include "sdlEngine.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+// READY LIST -----------------------------------------------------------------
+
+void pushReady(sdl_engine_handle* engine, uint16_t id){
+    sdl_engine_slot* slot=&engine->slots[id];
+    if(slot->ready) return;
+
+    slot->ready=1;
+    slot->nextReady=SDL_ENGINE_NO_LINE;
+    if(engine->readyHead==SDL_ENGINE_NO_LINE){
+        engine->readyHead=id;
+    }else{
+        engine->slots[engine->readyTail].nextReady=id;
+    }
+    engine->readyTail=id;
+}
+
+// TIMER WHEEL ----------------------------------------------------------------
+
+void armTimer(sdl_engine_handle* engine, uint16_t id, uint32_t deadline){
+    sdl_engine_slot* slot=&engine->slots[id];
+    if(slot->timerArmed) return;
+
+    uint16_t* wheelSlot=&engine->wheel[deadline%SDL_ENGINE_WHEEL_LEN];
+    slot->deadline=deadline;
+    slot->timerArmed=1;
+    slot->timerPrev=SDL_ENGINE_NO_LINE;
+    slot->timerNext=*wheelSlot;
+    if(*wheelSlot!=SDL_ENGINE_NO_LINE) engine->slots[*wheelSlot].timerPrev=id;
+    *wheelSlot=id;
+}
+
+void disarmTimer(sdl_engine_handle* engine, uint16_t id){
+    sdl_engine_slot* slot=&engine->slots[id];
+    if(!slot->timerArmed) return;
+
+    if(slot->timerPrev!=SDL_ENGINE_NO_LINE){
+        engine->slots[slot->timerPrev].timerNext=slot->timerNext;
+    }else{
+        engine->wheel[slot->deadline%SDL_ENGINE_WHEEL_LEN]=slot->timerNext;
+    }
+    if(slot->timerNext!=SDL_ENGINE_NO_LINE) engine->slots[slot->timerNext].timerPrev=slot->timerPrev;
+    slot->timerArmed=0;
+}
+
+//arms the ack timer if the line is waiting for an ack, otherwise signals the
+//transmission outcome to the user (if the timer was armed)
+void updateTimer(sdl_engine_handle* engine, uint16_t id){
+    sdl_engine_slot* slot=&engine->slots[id];
+    uint8_t state=sdlTxState(slot->line);
+
+    if(state==SDL_TX_WAIT_ACK){
+        uint32_t deadline=slot->line->txStart+slot->line->timeout+1;
+        if(slot->timerArmed && slot->deadline==deadline) return;
+        disarmTimer(engine,id);
+        armTimer(engine,id,deadline);
+    }else if(slot->timerArmed){
+        disarmTimer(engine,id);
+        if(engine->txDoneFunc!=NULL) engine->txDoneFunc(engine,id,state==SDL_TX_ACKED);
+    }
+}
+
+// LINE SERVICE ---------------------------------------------------------------
+
+//receives frames from a line, forwarding them or giving them to the user
+//returns the number of received frames
+uint32_t serviceLine(sdl_engine_handle* engine, uint16_t id){
+    sdl_engine_slot* slot=&engine->slots[id];
+    uint32_t frameNum=0;
+
+    while(frameNum<SDL_ENGINE_POLL_BUDGET){
+        uint32_t len=sdlPoll(slot->line,engine->rxArray,sizeof(engine->rxArray));
+        if(!len) break;
+        frameNum++;
+
+        if(slot->route!=SDL_ENGINE_NO_LINE){
+            if(!sdlEngineSend(engine,slot->route,engine->rxArray,len,slot->routeAck)) engine->dropped++;
+        }else if(engine->rxFunc!=NULL){
+            engine->rxFunc(engine,id,engine->rxArray,len);
+        }
+    }
+
+    //if the budget (of the engine or of sdlPoll()) is over there can be
+    //other frames, keep the line ready
+    if(frameNum==SDL_ENGINE_POLL_BUDGET || sdlRxPending(slot->line)) pushReady(engine,id);
+
+    //the ack may have been received
+    if(slot->timerArmed) updateTimer(engine,id);
+
+    return frameNum;
+}
+
+//processes the expired timers of a wheel slot
+void serviceWheelSlot(sdl_engine_handle* engine, uint32_t wheelIndx, uint32_t now){
+    uint16_t id=engine->wheel[wheelIndx];
+
+    while(id!=SDL_ENGINE_NO_LINE){
+        sdl_engine_slot* slot=&engine->slots[id];
+        uint16_t next=slot->timerNext;
+
+        //timers of the next rounds stay in the slot
+        if((int32_t)(now-slot->deadline)>=0){
+            //give a last chance to the ack before retransmitting
+            serviceLine(engine,id);
+            if(slot->timerArmed){
+                sdlCheckTimeout(slot->line);
+                //re-arming the timer (or signaling the outcome)
+                updateTimer(engine,id);
+            }
+        }
+
+        id=next;
+    }
+}
+
+// ENGINE FUNCTIONS -----------------------------------------------------------
+
+void sdlEngineInit(sdl_engine_handle* engine, void (*rxFunc)(sdl_engine_handle* engine, uint32_t id, uint8_t* buff, uint32_t len), void (*txDoneFunc)(sdl_engine_handle* engine, uint32_t id, uint8_t acked)){
+    if(engine==NULL) return;
+
+    engine->lineNum=0;
+    engine->readyHead=SDL_ENGINE_NO_LINE;
+    engine->readyTail=SDL_ENGINE_NO_LINE;
+    for(uint32_t w=0;w<SDL_ENGINE_WHEEL_LEN;w++) engine->wheel[w]=SDL_ENGINE_NO_LINE;
+    engine->wheelTick=sdlTimeTick();
+    engine->dropped=0;
+    engine->rxFunc=rxFunc;
+    engine->txDoneFunc=txDoneFunc;
+}
+
+uint32_t sdlEngineAddLine(sdl_engine_handle* engine, serial_line_handle* line){
+    if(engine==NULL || line==NULL) return SDL_ENGINE_NO_LINE;
+
+    //frames of lines with a handler would never reach the engine
+    if(line->rxHandler!=NULL) return SDL_ENGINE_NO_LINE;
+
+    if(engine->lineNum>=SDL_ENGINE_MAX_LINES) return SDL_ENGINE_NO_LINE;
+
+    uint16_t id=engine->lineNum;
+    sdl_engine_slot* slot=&engine->slots[id];
+    slot->line=line;
+    slot->route=SDL_ENGINE_NO_LINE;
+    slot->routeAck=0;
+    slot->ready=0;
+    slot->timerArmed=0;
+    engine->lineNum++;
+
+    //the line could already have received something
+    pushReady(engine,id);
+
+    return id;
+}
+
+uint8_t sdlEngineSetRoute(sdl_engine_handle* engine, uint32_t from, uint32_t to, uint8_t ackWanted){
+    if(engine==NULL || from>=engine->lineNum) return 0;
+
+    if(to!=SDL_ENGINE_NO_LINE && to>=engine->lineNum) return 0;
+
+    engine->slots[from].route=to;
+    engine->slots[from].routeAck=ackWanted;
+
+    return 1;
+}
+
+void sdlEngineNotify(sdl_engine_handle* engine, uint32_t id){
+    if(engine==NULL || id>=engine->lineNum) return;
+
+    pushReady(engine,id);
+}
+
+uint8_t sdlEngineSend(sdl_engine_handle* engine, uint32_t id, uint8_t* buff, uint32_t len, uint8_t ackWanted){
+    if(engine==NULL || id>=engine->lineNum) return 0;
+
+    if(!sdlSendAsync(engine->slots[id].line,buff,len,ackWanted)) return 0;
+
+    if(ackWanted) updateTimer(engine,id);
+
+    return 1;
+}
+
+uint32_t sdlEngineService(sdl_engine_handle* engine){
+    if(engine==NULL) return 0;
+
+    uint32_t frameNum=0;
+
+    //detaching the ready list, lines notified from now on are processed next round
+    uint16_t id=engine->readyHead;
+    engine->readyHead=SDL_ENGINE_NO_LINE;
+    engine->readyTail=SDL_ENGINE_NO_LINE;
+    while(id!=SDL_ENGINE_NO_LINE){
+        uint16_t next=engine->slots[id].nextReady;
+        engine->slots[id].ready=0;
+        frameNum+=serviceLine(engine,id);
+        id=next;
+    }
+
+    //advancing the timer wheel up to the current tick
+    uint32_t now=sdlTimeTick();
+    uint32_t steps=now-engine->wheelTick;
+    if(steps>=SDL_ENGINE_WHEEL_LEN){
+        //too late, every slot has to be checked
+        for(uint32_t w=0;w<SDL_ENGINE_WHEEL_LEN;w++) serviceWheelSlot(engine,w,now);
+    }else{
+        for(uint32_t s=1;s<=steps;s++) serviceWheelSlot(engine,(engine->wheelTick+s)%SDL_ENGINE_WHEEL_LEN,now);
+    }
+    engine->wheelTick=now;
+
+    return frameNum;
+}
+
+#ifdef __linux__
+int sdlEngineWaitEpoll(sdl_engine_handle* engine, int epfd, int timeoutMs){
+    if(engine==NULL) return -1;
+
+    struct epoll_event events[SDL_ENGINE_EPOLL_BATCH];
+    int eventNum=epoll_wait(epfd,events,SDL_ENGINE_EPOLL_BATCH,timeoutMs);
+
+    for(int e=0;e<eventNum;e++) sdlEngineNotify(engine,events[e].data.u32);
+
+    sdlEngineService(engine);
+
+    return eventNum;
+}
+#endif
+#endif
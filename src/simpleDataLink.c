@@ -4,20 +4,56 @@
  * 
  */
 
+//syscall() is declared by unistd.h only with the GNU extensions (the wait
+//hook can also be enabled inside the header, so it's always defined on Linux)
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "simpleDataLink.h"
 
+#if defined(SDL_WAIT_HOOK) && defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
 #define FRAME_FLAG 0x7E
 #define ESCAPE_FLAG 0x7D
 #define INVERTBIT5(byte) (byte ^ 0x20) 
 
-#define CRC_POLY 0x1021 //16 bit crc polynomial
-#define CRC_INITIAL 0xFFFF //16 bit crc initial value
+#define CRC16_INITIAL 0xFFFF //16 bit crc initial value
+#define CRC32_INITIAL 0xFFFFFFFF //32 bit crc initial value (also xored on the result)
+
+//a line can receive if it has an rx function or the rx ring
+#ifdef SDL_RX_RING_LEN
+#define HAS_RX(line) 1
+#else
+#define HAS_RX(line) ((line)->rxFunc!=NULL)
+#endif
 
 #define FRMCODE_DATA 0x00//code for data frame
 #define FRMCODE_ACK 0x01//code for acknowledge frame
+#define FRMCODE_CREDIT 0x02//code for flow control frame (credit limit, or credit probe if ack wanted)
+#define FRMCODE_ECHO_REQ 0x03//code for echo request frame (latency probe)
+#define FRMCODE_ECHO_REP 0x04//code for echo reply frame
+
+//frame flags (ackWanted header field)
+#define FRMFLAG_ACK 0x01 //frame wants an ack
+#define FRMFLAG_COMPRESSED 0x02 //payload is compressed
+
+//compact header fields (first header byte)
+#define COMPACT_MARK 0x80 //compact header marker (never set in full header codes)
+#define COMPACT_ACK 0x40 //ack wanted flag
+#define COMPACT_COMPRESSED 0x20 //payload compressed flag
+#define COMPACT_CODE 0x1F //frame code mask
+#define COMPACT_HEADER_LEN 2 //compact header length (second byte is the sequence number)
 
-//counter used to generate unique hashes for identical frames
-uint16_t hashCnt=0;
+//bit of the scan miss mask corresponding to a frame code (codes < 8)
+#define SCANMISS(code) ((uint8_t)(1<<(code)))
+
+#define BATCH_ACKS 8 //acks deferred by sdlReceiveBatch() before being sent
 
 //rules for frame search
 const uint8_t headTail=FRAME_FLAG;
@@ -27,7 +63,7 @@ search_frame_rule rule={
 	.tail=(uint8_t *)&headTail,	
 	.tailLen=1,
 	.minLen=1,
-	.maxLen=(SDL_MAX_PAY_LEN+2)*2,
+	.maxLen=SDL_LINE_BUFF_LEN(SDL_MAX_PAY_LEN)-2, //changed for every line, see receiveFrame()
 	.policy=hard,
 };
 
@@ -43,6 +79,14 @@ uint16_t netToNum16(uint8_t net[2]){
     return ((uint16_t)net[0]<<8) | ((uint16_t)net[1]);
 }
 
+void num32ToNet(uint8_t net[4], uint32_t num){
+    for(uint32_t b=0;b<4;b++) net[b]=(uint8_t)((num>>(8*(3-b))) & 0xFF);
+}
+
+uint32_t netToNum32(uint8_t net[4]){
+    return ((uint32_t)net[0]<<24) | ((uint32_t)net[1]<<16) | ((uint32_t)net[2]<<8) | ((uint32_t)net[3]);
+}
+
 // STUFFING -------------------------------------------------------------------
 
 uint8_t doByteStuffing(circular_buffer_handle* data){
@@ -116,132 +160,318 @@ uint8_t undoByteStuffing(circular_buffer_handle* data){
 
 // CRC/HASH -------------------------------------------------------------------
 
-/*
-//this function can be used to verify other CRC implementations
-//this should not be used in production in favor of the LUT implementation
-uint16_t computeCRC(circular_buffer_handle* dataBuff){
-	if(dataBuff==NULL || dataBuff->buff==NULL) return 0;
-
-	const uint16_t poly=CRC_POLY;
-	const uint16_t initVal=CRC_INITIAL;
-
-	uint16_t crc=initVal;
+//look-up tables, generated at build time by tools/crcTableGen.c
+#include "crcTables.h"
 
-	for(uint32_t b=0;b<dataBuff->elemNum;b++){
-		uint16_t byte=((uint16_t)cBuffReadByte(dataBuff,0,b));
-
-		crc=(byte << 8) ^ crc;
+//the SSE4.2 crc32 instruction computes the CRC-32C
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32C_HW
+#endif
 
-		for(uint8_t bit=0;bit<8;bit++){
-			if(crc & 0x8000){
-				crc=(crc<<1) ^ poly;
-			}else{
-				crc=crc<<1;
-			}
-		}
-	}
+//returns the length of the CRC on the frame
+uint32_t crcLen(uint8_t crcType){
+    return (crcType==SDL_CRC16) ? 2 : 4;
+}
 
-	return crc;
+uint16_t crc16Span(uint16_t crc, uint8_t* data, uint32_t len){
+    for(uint32_t b=0;b<len;b++){
+        crc=(crc<<8) ^ CRC16LUT[(uint8_t)((crc>>8) ^ data[b])];
+    }
 
+    return crc;
 }
-*/
 
-/*
-//this function can be used to print a CRC LUT on the terminal
-#include <stdio.h>
-void printCRCLUT(){
-    uint16_t poly=CRC_POLY;
-
-	uint8_t byteVal=0;
-	printf("const uint16_t CRCLUT%04x[]={\n",poly);
-	do{
-		uint16_t crc=byteVal<<8;
-		for(uint8_t bit=0;bit<8;bit++){
-			if(crc & 0x8000){
-				crc=(crc<<1) ^ poly;
-			}else{
-				crc=crc<<1;
-			}
-		}
-		printf("0x%04x, ",crc);
-		byteVal++;
-		if(!(byteVal%16)) printf("\n");
-	}while(byteVal!=0);
-	printf("};");
-}
-*/
-
-const uint16_t CRCLUT1021[]={
-0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7, 0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
-0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6, 0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
-0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485, 0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
-0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4, 0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
-0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823, 0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
-0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12, 0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
-0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41, 0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
-0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70, 0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
-0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f, 0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
-0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e, 0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
-0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d, 0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
-0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c, 0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
-0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab, 0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
-0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a, 0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
-0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9, 0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
-0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8, 0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
-};
+uint32_t crc32Span(const uint32_t* lut, uint32_t crc, uint8_t* data, uint32_t len){
+    for(uint32_t b=0;b<len;b++){
+        crc=(crc>>8) ^ lut[(uint8_t)(crc ^ data[b])];
+    }
 
-uint16_t computeCRCwithLUT(circular_buffer_handle* dataBuff){
-	if(dataBuff==NULL || dataBuff->buff==NULL) return 0;
+    return crc;
+}
 
-	const uint16_t initVal=CRC_INITIAL;
+#ifdef CRC32C_HW
+//crc32 instruction availability, written only once before main() so that
+//lines used by different threads can read it without synchronization
+uint8_t crc32cHwAvail=0;
 
-	uint16_t crc=initVal;
+__attribute__((constructor))
+void crc32cHwInit(){
+    __builtin_cpu_init();
+    crc32cHwAvail=__builtin_cpu_supports("sse4.2") ? 1 : 0;
+}
 
-	for(uint32_t b=0;b<dataBuff->elemNum;b++){
-		uint16_t byte=((uint16_t)cBuffReadByte(dataBuff,0,b));
+__attribute__((target("sse4.2")))
+uint32_t crc32cHwSpan(uint32_t crc, uint8_t* data, uint32_t len){
+#ifdef __x86_64__
+    uint64_t crc64=crc;
+    while(len>=8){
+        uint64_t word;
+        __builtin_memcpy(&word,data,8);
+        crc64=__builtin_ia32_crc32di(crc64,word);
+        data+=8;
+        len-=8;
+    }
+    crc=(uint32_t)crc64;
+#endif
+    while(len>=4){
+        uint32_t word;
+        __builtin_memcpy(&word,data,4);
+        crc=__builtin_ia32_crc32si(crc,word);
+        data+=4;
+        len-=4;
+    }
+    while(len--) crc=__builtin_ia32_crc32qi(crc,*data++);
 
-		crc=(byte<<8) ^ crc;
+    return crc;
+}
+#endif
 
-		crc=(crc<<8) ^ CRCLUT1021[(uint8_t) (crc>>8)];
-	}
+//computes the CRC of the first len bytes of dataBuff
+//works directly on the (at most two) contiguous spans of the buffer memory array
+uint32_t computeCRC(circular_buffer_handle* dataBuff, uint32_t len, uint8_t crcType){
+    uint8_t* span[2];
+    uint32_t spanLen[2];
+    span[0]=&dataBuff->buff[dataBuff->startIndex];
+    spanLen[0]=dataBuff->buffLen-dataBuff->startIndex;
+    if(spanLen[0]>len) spanLen[0]=len;
+    span[1]=dataBuff->buff;
+    spanLen[1]=len-spanLen[0];
+
+    uint32_t crc;
+    switch(crcType){
+        case SDL_CRC32:
+            crc=CRC32_INITIAL;
+            for(uint8_t s=0;s<2;s++) crc=crc32Span(CRC32LUT,crc,span[s],spanLen[s]);
+            return crc ^ CRC32_INITIAL;
+
+        case SDL_CRC32C:
+            crc=CRC32_INITIAL;
+#ifdef CRC32C_HW
+            if(crc32cHwAvail){
+                for(uint8_t s=0;s<2;s++) crc=crc32cHwSpan(crc,span[s],spanLen[s]);
+                return crc ^ CRC32_INITIAL;
+            }
+#endif
+            for(uint8_t s=0;s<2;s++) crc=crc32Span(CRC32CLUT,crc,span[s],spanLen[s]);
+            return crc ^ CRC32_INITIAL;
 
-	return crc;
+        default:
+            crc=CRC16_INITIAL;
+            for(uint8_t s=0;s<2;s++) crc=crc16Span(crc,span[s],spanLen[s]);
+            return crc;
+    }
 }
 
-uint8_t addCRC(circular_buffer_handle* data){
+uint8_t addCRC(circular_buffer_handle* data, uint8_t crcType){
     if(data==NULL || data->buff==NULL || data->buffLen==0) return 0;
 
-    uint16_t CRC=computeCRCwithLUT(data);
+    uint32_t CRC=computeCRC(data,data->elemNum,crcType);
+    uint32_t len=crcLen(crcType);
     //append crc to frame (network order)
-    uint8_t tmpCRC[2];
-    num16ToNet(tmpCRC,CRC);
-    if(cBuffPushToFill(data,tmpCRC,2,1) == 2) return 1;
+    uint8_t tmpCRC[4];
+    for(uint32_t b=0;b<len;b++) tmpCRC[b]=(uint8_t)(CRC>>(8*(len-1-b)));
+    if(cBuffPushToFill(data,tmpCRC,len,1) == len) return 1;
     //else
     return 0;
 }
 
-uint8_t removeVerifyCRC(circular_buffer_handle* data){
-    if(data==NULL || data->buff==NULL || data->buffLen==0 || data->elemNum<2) return 0;
+uint8_t removeVerifyCRC(circular_buffer_handle* data, uint8_t crcType){
+    uint32_t len=crcLen(crcType);
+    if(data==NULL || data->buff==NULL || data->buffLen==0 || data->elemNum<len) return 0;
 
-    //compute CRC (should be 0)
-    uint16_t CRC=computeCRCwithLUT(data);
+    //compute CRC (without the received one)
+    uint32_t CRC=computeCRC(data,data->elemNum-len,crcType);
+    //read received CRC (network order)
+    uint32_t rxCRC=0;
+    for(uint32_t b=0;b<len;b++) rxCRC=(rxCRC<<8) | cBuffReadByte(data,0,data->elemNum-len+b);
     //pull CRC bytes from buffer
-    cBuffPull(data,NULL,2,1);
+    cBuffPull(data,NULL,len,1);
 
-    if(!CRC) return 1;
+    if(CRC==rxCRC) return 1;
     //else
     return 0;
 }
 
 /* this function computes an hash starting from a buffer of data
- * right now it simply returns the value of the hash counter to
+ * right now it simply returns the value of the line hash counter to
  * generate the hash, it can be modified to implement more robust
  * types of hashes but in our case we will only use it to identify
  * frames uniquely for acknowledges so it should be good enough
  */
-uint16_t computeHash(uint8_t * hashData, uint32_t dataLen){
-    return ++hashCnt;
+uint16_t computeHash(serial_line_handle* line, uint8_t * hashData, uint32_t dataLen){
+    //0 is skipped since it's the initial value of the last received hash
+    if(!++line->hashCnt) line->hashCnt++;
+    return line->hashCnt;
+}
+
+//generates the hash of a new data frame of the line
+//compact headers only carry an 8 bit sequence number (counted per line, skipping 0)
+uint16_t nextHash(serial_line_handle* line, uint8_t* buff, uint32_t len){
+    if(line->compactHeader){
+        line->txSeq=(line->txSeq%255)+1;
+        return line->txSeq;
+    }
+
+    return computeHash(line,buff,len);
+}
+
+//writes the header in wire format (network ordered) inside out (at least sizeof(frameHeader) bytes)
+//returns the header length
+uint32_t packHeader(uint8_t* out, frameHeader* header, uint8_t compact){
+    if(compact){
+        out[0]=COMPACT_MARK | (header->code & COMPACT_CODE);
+        if(header->ackWanted & FRMFLAG_ACK) out[0]|=COMPACT_ACK;
+        if(header->ackWanted & FRMFLAG_COMPRESSED) out[0]|=COMPACT_COMPRESSED;
+        out[1]=(uint8_t)header->hash;
+        return COMPACT_HEADER_LEN;
+    }
+
+    out[0]=header->code;
+    out[1]=header->ackWanted;
+    num16ToNet(&out[2],header->hash);
+    return sizeof(frameHeader);
+}
+
+//reads the header of the frame inside frame buffer (without removing it), detecting its profile
+//the header is written host ordered in header
+//returns the header length (COMPACT_HEADER_LEN for compact headers), 0 if the frame is too short
+uint32_t readHeader(circular_buffer_handle* frame, frameHeader* header){
+    uint8_t raw[sizeof(frameHeader)];
+
+    if(cBuffRead(frame,raw,1,0,0)!=1) return 0;
+
+    if(raw[0] & COMPACT_MARK){
+        if(cBuffRead(frame,raw,COMPACT_HEADER_LEN,0,0)!=COMPACT_HEADER_LEN) return 0;
+        header->code=raw[0] & COMPACT_CODE;
+        header->ackWanted=(raw[0] & COMPACT_ACK) ? FRMFLAG_ACK : 0;
+        if(raw[0] & COMPACT_COMPRESSED) header->ackWanted|=FRMFLAG_COMPRESSED;
+        header->hash=raw[1];
+        return COMPACT_HEADER_LEN;
+    }
+
+    if(cBuffRead(frame,raw,sizeof(frameHeader),0,0)!=sizeof(frameHeader)) return 0;
+    header->code=raw[0];
+    header->ackWanted=raw[1];
+    header->hash=netToNum16(&raw[2]);
+    return sizeof(frameHeader);
+}
+
+#ifdef SDL_COMPRESS_HASH_BITS
+// COMPRESSION ----------------------------------------------------------------
+//LZF-like codec, the compressed payload is a sequence of:
+// 000LLLLL                    literal run of L+1 bytes (following the control byte)
+// LLLOOOOO OOOOOOOO           back reference of L+2 bytes at distance O+1 (L from 1 to 6)
+// 111OOOOO LLLLLLLL OOOOOOOO  back reference of L+9 bytes at distance O+1
+
+#define LZF_MAX_LIT 32 //maximum literal run
+#define LZF_MAX_OFF 8192 //maximum back reference distance
+#define LZF_MAX_REF (255+9) //maximum back reference length
+#define LZF_NO_REF 0xFFFF //empty hash table entry
+#define LZF_HASH(p) ((((uint32_t)(p)[0]<<16 | (uint32_t)(p)[1]<<8 | (p)[2])*2654435761u)>>(32-SDL_COMPRESS_HASH_BITS))
+
+_Static_assert(SDL_MAX_PAY_LEN<LZF_NO_REF,"SDL_MAX_PAY_LEN too long for the compression hash table");
+
+//compresses inLen bytes of in inside out
+//returns the compressed length, 0 if it's longer than outLen
+uint32_t lzfCompress(uint8_t* in, uint32_t inLen, uint8_t* out, uint32_t outLen){
+    //positions of the last occurrence of each 3 bytes hash
+    uint16_t htab[1<<SDL_COMPRESS_HASH_BITS];
+    for(uint32_t h=0;h<(1<<SDL_COMPRESS_HASH_BITS);h++) htab[h]=LZF_NO_REF;
+
+    uint32_t ip=0;
+    uint32_t op=1; //out[0] is reserved for the control byte of the first literal run
+    uint32_t litPos=0; //position of the control byte of the current literal run
+    uint32_t lit=0; //length of the current literal run
+
+    while(ip<inLen){
+        uint32_t ref=LZF_NO_REF;
+        if((ip+2)<inLen){
+            uint32_t h=LZF_HASH(&in[ip]);
+            ref=htab[h];
+            htab[h]=ip;
+        }
+
+        if(ref!=LZF_NO_REF && (ip-ref-1)<LZF_MAX_OFF && in[ref]==in[ip] && in[ref+1]==in[ip+1] && in[ref+2]==in[ip+2]){
+            uint32_t off=ip-ref-1;
+            //match length
+            uint32_t maxLen=inLen-ip;
+            if(maxLen>LZF_MAX_REF) maxLen=LZF_MAX_REF;
+            uint32_t len=3;
+            while(len<maxLen && in[ref+len]==in[ip+len]) len++;
+
+            //closing the literal run (or removing its unused control byte)
+            if(lit) out[litPos]=lit-1;
+            else op--;
+
+            //back reference (up to 3 bytes) plus the next control byte
+            if((op+4)>outLen) return 0;
+            if((len-2)<7){
+                out[op++]=((len-2)<<5) | (off>>8);
+            }else{
+                out[op++]=(7<<5) | (off>>8);
+                out[op++]=len-9;
+            }
+            out[op++]=(uint8_t)off;
+
+            //hashing the positions inside the match
+            for(uint32_t b=ip+1;b<(ip+len) && (b+2)<inLen;b++) htab[LZF_HASH(&in[b])]=b;
+            ip+=len;
+
+            //starting a new literal run
+            lit=0;
+            litPos=op++;
+        }else{
+            if(op>=outLen) return 0;
+            out[op++]=in[ip++];
+            lit++;
+            if(lit==LZF_MAX_LIT){
+                out[litPos]=lit-1;
+                lit=0;
+                litPos=op++;
+            }
+        }
+    }
+
+    //closing the last literal run (or removing its unused control byte)
+    if(lit) out[litPos]=lit-1;
+    else op--;
+
+    return op;
+}
+
+//decompresses inLen bytes of in inside out
+//returns the decompressed length, 0 if the data is not valid or longer than outLen
+uint32_t lzfDecompress(uint8_t* in, uint32_t inLen, uint8_t* out, uint32_t outLen){
+    uint32_t ip=0;
+    uint32_t op=0;
+
+    while(ip<inLen){
+        uint32_t ctrl=in[ip++];
+
+        if(ctrl<LZF_MAX_LIT){
+            //literal run
+            uint32_t len=ctrl+1;
+            if((ip+len)>inLen || (op+len)>outLen) return 0;
+            for(uint32_t b=0;b<len;b++) out[op++]=in[ip++];
+        }else{
+            //back reference
+            uint32_t len=ctrl>>5;
+            if(len==7){
+                if(ip>=inLen) return 0;
+                len+=in[ip++];
+            }
+            len+=2;
+            if(ip>=inLen) return 0;
+            uint32_t off=(((ctrl & 0x1F)<<8) | in[ip++])+1;
+            if(off>op || (op+len)>outLen) return 0;
+            //byte by byte since the reference can overlap the output
+            for(uint32_t b=0;b<len;b++,op++) out[op]=out[op-off];
+        }
+    }
+
+    return op;
 }
+#endif
 
 // FRAME/DEFRAME FUNCTIONS ----------------------------------------------------
 
@@ -251,11 +481,12 @@ uint16_t computeHash(uint8_t * hashData, uint32_t dataLen){
  * This function takes a payload under the form of a bufferUtils circular
  * buffer and frames it inside a frame with the following format:
  * 
- * |FLAG| PAYLOAD | CRC16 |FLAG|
+ * |FLAG| PAYLOAD | CRC |FLAG|
  * 
- * Where the flag is 0x7E and the CRC16 is computed by using 0x1021 and
- * initial value of 0xFFFF, the CRC is appended to the frame in network
- * order (big endian) regardless of the architecture.
+ * Where the flag is 0x7E and the CRC is of the given type (by default a
+ * CRC16 computed by using 0x1021 and initial value of 0xFFFF), the CRC is
+ * appended to the frame in network order (big endian) regardless of the
+ * architecture.
  * 
  * The function then performs an HDLC-like byte stuffing: the flag byte
  * 0x7E and the escape byte 0x7D are replaced by 0x7D followed by the
@@ -276,13 +507,14 @@ uint16_t computeHash(uint8_t * hashData, uint32_t dataLen){
  * 
  * @param payload circular buffer handle containing the payload and inside
  *                which the frame will be built
+ * @param crcType type of CRC (SDL_CRC)
  * @return uint8_t 0 if an error occurred (buffer too small), !0 otherwise
  */
-uint8_t frame(circular_buffer_handle * payload){
+uint8_t frame(circular_buffer_handle * payload, uint8_t crcType){
     if(payload==NULL || payload->buff==NULL) return 0;
 
     //add crc to buffer
-    if(!addCRC(payload)) return 0;
+    if(!addCRC(payload,crcType)) return 0;
 
     //perform byte stuffing
     if(!doByteStuffing(payload)) return 0;
@@ -310,9 +542,10 @@ uint8_t frame(circular_buffer_handle * payload){
  * 
  * @param frame circular buffer handle containing the frame and inside which
  *              the payload will be written
+ * @param crcType type of CRC (SDL_CRC)
  * @return uint8_t 0 if an error occurred, !0 otherwise
  */
-uint8_t deframe(circular_buffer_handle * frame){
+uint8_t deframe(circular_buffer_handle * frame, uint8_t crcType){
     if(frame==NULL || frame->buff==NULL) return 0;
 
     //remove head and tail
@@ -326,104 +559,491 @@ uint8_t deframe(circular_buffer_handle * frame){
     if(!undoByteStuffing(frame)) return 0;
 
     //remove and verify CRC
-    if(!removeVerifyCRC(frame)) return 0;
+    if(!removeVerifyCRC(frame,crcType)) return 0;
 
     return 1;
 }
 
-// BASIC I/O FUNCTIONS --------------------------------------------------------
-//sends a frame on line txBuff
-uint8_t sendFrame(serial_line_handle* line, uint8_t frameCode, uint8_t ackWanted, uint16_t hash, uint8_t* buff, uint32_t len){
-    if(line==NULL || line->txFunc==NULL) return 0;
+// RX RING --------------------------------------------------------------------
+
+#ifdef SDL_RX_RING_LEN
+//moves the bytes pushed by the producer from the rx ring to rxBuff
+//frames are not deframed inside the ring: the scan and the cuts work on the
+//rxBuff circular buffer and frames not yet wanted (acks, partial frames) stay
+//there across calls, while the producer reuses the ring space as soon as the
+//tail moves, so this copy is the only one between the driver and tmpBuff
+//returns the number of moved bytes
+uint32_t pullRxRing(serial_line_handle* line){
+    //only the consumer writes the tail, the head needs acquire ordering to
+    //see the bytes written by the producer before moving it
+    uint32_t tail=atomic_load_explicit(&line->rxRingTail,memory_order_relaxed);
+    uint32_t head=atomic_load_explicit(&line->rxRingHead,memory_order_acquire);
+    uint32_t moved=0;
+
+    while(tail!=head){
+        uint32_t indx=tail & (SDL_RX_RING_LEN-1);
+        //contiguous bytes until the ring end
+        uint32_t span=SDL_RX_RING_LEN-indx;
+        if(span>(head-tail)) span=head-tail;
+        uint32_t pushed=cBuffPushToFill(&line->rxBuff,&line->rxRingArray[indx],span,1);
+        tail+=pushed;
+        moved+=pushed;
+        if(pushed<span) break; //rxBuff full
+    }
+
+    //release ordering so that the producer sees the bytes as read before reusing them
+    atomic_store_explicit(&line->rxRingTail,tail,memory_order_release);
+
+    return moved;
+}
+#endif
+
+//fills rxBuff with the new bytes of the line (from rx ring and rxFunc)
+//returns the number of new bytes
+uint32_t fillRxBuff(serial_line_handle* line){
+    uint32_t added=0;
+
+#ifdef SDL_RX_RING_LEN
+    added+=pullRxRing(line);
+#endif
+
+    if(line->rxFunc!=NULL){
+        uint8_t byte;
+        while(!cBuffFull(&line->rxBuff)){
+            if(line->rxFunc(&byte)){
+                cBuffPush(&line->rxBuff,&byte,1,1);
+                added++;
+            }else break;
+        }
+    }
+
+#ifdef SDL_FLOW_CTRL
+    //counting received bytes for the flow control credits
+    line->rxIn+=added;
+#endif
+
+    return added;
+}
+
+#ifdef SDL_FLOW_CTRL
+// FLOW CONTROL ---------------------------------------------------------------
+//the receiver counts the bytes entering rxBuff and advertises as limit the
+//count it will reach once rxBuff is full, the sender counts the bytes it sends
+//and holds data frames which would go past the limit (both modulo 2^16)
+
+//gets the credit limit of the line receiving side
+uint16_t creditLimit(serial_line_handle* line){
+    return (uint16_t)(line->rxIn+(line->rxBuff.buffLen-line->rxBuff.elemNum));
+}
+
+//returns !0 if len bytes can be sent without going past the receiver limit, 0 otherwise
+uint8_t creditAvail(serial_line_handle* line, uint32_t len){
+    return (int32_t)(int16_t)(line->txLimit-line->txSent)>=(int32_t)len;
+}
+
+//marks the line as holding a data frame for lack of credits
+void holdCredit(serial_line_handle* line){
+    if(line->txBlocked) return;
+
+    line->txBlocked=1;
+    line->txBlockTick=sdlTimeTick();
+    //if the receiver never advertised a limit, it's probed right away
+    if(!line->txCredited) line->txBlockTick-=line->timeout+1;
+}
+#endif
+
+#ifdef SDL_PACING
+// PACING ---------------------------------------------------------------------
+//refills the line token bucket with the bytes allowed since the last refill
+void rateRefill(serial_line_handle* line){
+    uint32_t now=sdlTimeTick();
+    int64_t tokens=line->rateTokens+(int64_t)(now-line->rateTick)*line->rateBytes;
+    line->rateTick=now;
+
+    line->rateTokens=(tokens>line->rateBurst) ? (int32_t)line->rateBurst : (int32_t)tokens;
+}
+
+//returns !0 if a frame of len bytes can be sent by the pacing, 0 otherwise
+//(frames longer than the bucket only need it full)
+uint8_t rateAvail(serial_line_handle* line, uint32_t len){
+    if(!line->rateBytes) return 1;
+
+    if(len>line->rateBurst) len=line->rateBurst;
+    if(line->rateTokens<(int32_t)len) rateRefill(line);
+
+    line->ratePending=(line->rateTokens<(int32_t)len) ? len : 0;
+
+    return !line->ratePending;
+}
+
+//takes the tokens of len bytes sent on the line
+void rateCharge(serial_line_handle* line, uint32_t len){
+    if(line->rateBytes) line->rateTokens-=len;
+}
+
+//returns the ticks needed to refill the tokens of the data frame held by the pacing
+uint32_t rateTicks(serial_line_handle* line){
+    //tokens are refilled once per tick
+    int64_t missing=(int64_t)line->ratePending-line->rateTokens;
+    uint32_t ticks=(uint32_t)((missing+line->rateBytes-1)/line->rateBytes);
+
+    return ticks ? ticks : 1;
+}
+#endif
+
+#ifdef SDL_WAIT_HOOK
+// WAIT HOOK ------------------------------------------------------------------
+//reads the line wake sequence number, must be done before checking the line
+uint32_t wakeSeq(serial_line_handle* line){
+    return atomic_load_explicit(&line->wakeSeq,memory_order_acquire);
+}
+
+//sleeps inside the line wait function for at most ticks (if nothing was
+//signaled after seq was read), then reads the new sequence number inside seq
+void waitWake(serial_line_handle* line, uint32_t* seq, uint32_t ticks){
+    if(line->waitFunc!=NULL && ticks){
+        //the waiting flag and the sequence number are both sequentially
+        //consistent, so either sdlNotify() sees the flag or we see its increment
+        atomic_store(&line->wakeWaiting,1);
+        if(atomic_load(&line->wakeSeq)==*seq) line->waitFunc(line,*seq,ticks,line->waitCtx);
+        atomic_store(&line->wakeWaiting,0);
+    }
+
+    *seq=wakeSeq(line);
+}
+#endif
+
+#ifdef SDL_TRACE_LEN
+// TRACE ----------------------------------------------------------------------
+#define TRACE_PSEUDO_LEN 8 //length of the pcap pseudo-header (event, arg, hash, frame length)
+#define TRACE_LINKTYPE 147 //pcap LINKTYPE_USER0
+
+//copies the first bytes of frame inside the scratch record, they are moved in
+//the ring by the following frame event (the next ring record can still be
+//the oldest one, which must stay intact until an event is written)
+void traceCapture(serial_line_handle* line, circular_buffer_handle* frame){
+    sdl_trace_rec* rec=&line->traceScratch;
 
-    if(len>SDL_MAX_PAY_LEN) return 0;
+    rec->frameLen=frame->elemNum;
+    rec->capLen=cBuffRead(frame,rec->cap,(frame->elemNum<SDL_TRACE_SNAP_LEN) ? frame->elemNum : SDL_TRACE_SNAP_LEN,0,0);
+}
+
+//writes an event on the next trace record (frame events keep the bytes taken by traceCapture())
+void traceEvent(serial_line_handle* line, uint8_t event, uint16_t hash, uint32_t arg){
+    sdl_trace_rec* rec=&line->traceRing[line->traceHead & (SDL_TRACE_LEN-1)];
+
+    rec->time=SDL_TRACE_CLOCK();
+    rec->event=event;
+    rec->arg=(arg>0xFF) ? 0xFF : arg;
+    rec->hash=hash;
+    if(event==SDL_TRACE_TX || event==SDL_TRACE_RX || event==SDL_TRACE_CRC){
+        rec->frameLen=line->traceScratch.frameLen;
+        rec->capLen=line->traceScratch.capLen;
+        for(uint32_t b=0;b<rec->capLen;b++) rec->cap[b]=line->traceScratch.cap[b];
+    }else{
+        rec->frameLen=0;
+        rec->capLen=0;
+    }
+
+    line->traceHead++;
+}
+#endif
+
+// BASIC I/O FUNCTIONS --------------------------------------------------------
+//builds a frame inside line tmpBuff, ready to be transmitted (with a compact header if compact is !0)
+uint8_t buildFrame(serial_line_handle* line, uint8_t frameCode, uint8_t ackWanted, uint16_t hash, uint8_t* buff, uint32_t len, uint8_t compact){
+    if(len>line->maxPayLen) return 0;
 
     //initializing temporary circular buffer
-    cBuffInit(&line->tmpBuff,line->tmpBuffArray,sizeof(line->tmpBuffArray),0);
+    cBuffInit(&line->tmpBuff,line->tmpBuff.buff,line->tmpBuff.buffLen,0);
 
     //creating frameHeader
     frameHeader header={
         .code=frameCode,
-        .ackWanted=ackWanted,
+        .ackWanted=ackWanted ? FRMFLAG_ACK : 0,
         .hash=hash
     };
 
-    //network ordering header
-    num16ToNet((uint8_t*)&header.hash,header.hash);
+#ifdef SDL_COMPRESS_HASH_BITS
+    //compressing the payload, it's sent as it is if it doesn't shrink
+    uint8_t packed[SDL_MAX_PAY_LEN];
+    if(line->compress && buff!=NULL && len>1){
+        uint32_t packedLen=lzfCompress(buff,len,packed,len-1);
+        if(packedLen){
+            header.ackWanted|=FRMFLAG_COMPRESSED;
+            buff=packed;
+            len=packedLen;
+        }
+    }
+#endif
+
+    //packing header (network ordered)
+    uint8_t headerArray[sizeof(frameHeader)];
+    uint32_t headerLen=packHeader(headerArray,&header,compact);
 
     //copying header inside circular buffer
-    if(cBuffPushToFill(&line->tmpBuff,(uint8_t *)&header,sizeof(frameHeader),1)!=sizeof(frameHeader)) return 0;
+    if(cBuffPushToFill(&line->tmpBuff,headerArray,headerLen,1)!=headerLen) return 0;
 
     //copying data inside circular buffer
     if(buff!=NULL) if(cBuffPushToFill(&line->tmpBuff,buff,len,1)!=len) return 0;
 
+#ifdef SDL_TRACE_LEN
+    //logged only once the frame is actually sent
+    traceCapture(line,&line->tmpBuff);
+#endif
+
     //framing the payload
-    if(!frame(&line->tmpBuff)) return 0;
+    if(!frame(&line->tmpBuff,line->crcType)) return 0;
+
+    return 1;
+}
+
+//sends a frame on line txBuff
+uint8_t sendFrame(serial_line_handle* line, uint8_t frameCode, uint8_t ackWanted, uint16_t hash, uint8_t* buff, uint32_t len, uint8_t compact){
+    if(line==NULL || line->txFunc==NULL) return 0;
+
+    if(!buildFrame(line,frameCode,ackWanted,hash,buff,len,compact)) return 0;
+
+#ifdef SDL_FLOW_CTRL
+    //data frames are held if they don't fit inside the receiver window
+    if(frameCode==FRMCODE_DATA && line->flowControl){
+        if(!creditAvail(line,line->tmpBuff.elemNum)){
+            holdCredit(line);
+            return 0;
+        }
+        line->txBlocked=0;
+    }
+#endif
+
+#ifdef SDL_PACING
+    //data frames are held until the pacing allows them
+    if(frameCode==FRMCODE_DATA && !rateAvail(line,line->tmpBuff.elemNum)) return 0;
+    rateCharge(line,line->tmpBuff.elemNum);
+#endif
 
     //sending the payload through the line
     uint8_t byte;
     while(cBuffPull(&line->tmpBuff,&byte,1,0)){
         //if the transmission fails, return 0
         if(!line->txFunc(byte)) return 0;
+#ifdef SDL_FLOW_CTRL
+        line->txSent++;
+#endif
     }
+
+#ifdef SDL_TRACE_LEN
+    traceEvent(line,SDL_TRACE_TX,hash,0);
+#endif
  
     return 1;
 }
 
-//receives a frame from line rxBuff, searching for a certain frameCode, if some remCodes are specified (not NULL or empty)
-//it also removes those codes from rxBuff, otherwise it leaves them unchanged
-//the eventually received frame will be placed inside line tmpBuff (HEADER INCLUDED!)
-//returns 0 if no frame found, !0 otherwise
-uint8_t receiveFrame(serial_line_handle* line, uint8_t frameCode, circular_buffer_handle* remCodes){
-    if(line==NULL || line->rxFunc==NULL) return 0;
+#ifdef SDL_FLOW_CTRL
+//sends a credit frame: a probe carrying the sent bytes counter if probe is !0,
+//the receiver credit limit otherwise
+uint8_t sendCredit(serial_line_handle* line, uint8_t probe, uint16_t value){
+    uint8_t valueArray[2];
+    num16ToNet(valueArray,value);
+
+    return sendFrame(line,FRMCODE_CREDIT,probe,0,valueArray,sizeof(valueArray),line->compactHeader);
+}
+
+//advertises the receiver credit limit if it grew by at least half rxBuff since
+//the last advertisement (smaller updates travel with the acks)
+void updateCredit(serial_line_handle* line){
+    if(!line->flowControl || line->txFunc==NULL) return;
 
+    uint16_t limit=creditLimit(line);
+    if((uint16_t)(limit-line->rxAdvertised)<(line->rxBuff.buffLen/2)) return;
+
+    if(sendCredit(line,0,limit)) line->rxAdvertised=limit;
+}
+
+//handles the credits carried by a frame cut from rxBuff (credit frames and acks),
+//the frame is inside line tmpBuff (header included), rxFrom is the number of
+//bytes inside rxBuff from the beginning of the frame
+void handleCredit(serial_line_handle* line, frameHeader* header, uint32_t headerLen, uint32_t rxFrom){
+    if(!line->flowControl || (header->ackWanted & FRMFLAG_COMPRESSED)) return;
+    if((line->tmpBuff.elemNum-headerLen)!=2) return;
+
+    uint8_t valueArray[2];
+    cBuffRead(&line->tmpBuff,valueArray,sizeof(valueArray),0,headerLen);
+    uint16_t value=netToNum16(valueArray);
+
+    if(header->code==FRMCODE_CREDIT && (header->ackWanted & FRMFLAG_ACK)){
+        //probe, the received bytes counter is realigned with the sender one
+        //(bytes lost on the line would make the limit lag behind) and the
+        //current limit is sent back
+        line->rxIn=(uint16_t)(value+rxFrom);
+        line->rxAdvertised=creditLimit(line);
+        sendCredit(line,0,line->rxAdvertised);
+        return;
+    }
+
+    //limits only move forward (old credits can arrive after newer acks)
+    if(!line->txCredited || (int16_t)(value-line->txLimit)>0){
+        line->txLimit=value;
+        line->txBlockTick=sdlTimeTick();
+    }
+    line->txCredited=1;
+}
+#endif
+
+#ifdef SDL_PING
+// ROUND TRIP TIME ------------------------------------------------------------
+//adds a round trip time measure to the line statistics
+void rttSample(serial_line_handle* line, uint32_t rtt){
+    sdl_rtt_stats* stats=&line->rtt;
+
+    if(stats->replies){
+        //jitter estimator of RFC 3550: J+=(|D|-J)/16, kept multiplied by 16
+        uint32_t diff=(rtt>stats->last) ? rtt-stats->last : stats->last-rtt;
+        line->rttJitter+=diff-((line->rttJitter+8)>>4);
+        if(rtt<stats->min) stats->min=rtt;
+        if(rtt>stats->max) stats->max=rtt;
+    }else{
+        stats->min=rtt;
+        stats->max=rtt;
+    }
+
+    stats->replies++;
+    stats->last=rtt;
+    line->rttSum+=rtt;
+    stats->avg=(uint32_t)(line->rttSum/stats->replies);
+    stats->jitter=line->rttJitter>>4;
+}
+
+//sends an echo request carrying the current tick
+//returns its sequence number, 0 if it could not be sent
+uint8_t sendEcho(serial_line_handle* line){
+    uint8_t tickArray[4];
+    num32ToNet(tickArray,sdlTimeTick());
+
+    //sequence numbers skip 0 (fitting the compact header)
+    line->pingSeq=(line->pingSeq==0xFF) ? 1 : line->pingSeq+1;
+    if(!sendFrame(line,FRMCODE_ECHO_REQ,0,line->pingSeq,tickArray,sizeof(tickArray),line->compactHeader)) return 0;
+    line->rtt.requests++;
+
+    return line->pingSeq;
+}
+
+//handles an echo frame cut from rxBuff (the frame is inside line tmpBuff, header included)
+void handleEcho(serial_line_handle* line, frameHeader* header, uint32_t headerLen){
+    if((header->ackWanted & FRMFLAG_COMPRESSED) || (line->tmpBuff.elemNum-headerLen)!=4) return;
+
+    uint8_t tickArray[4];
+    cBuffRead(&line->tmpBuff,tickArray,sizeof(tickArray),0,headerLen);
+
+    if(header->code==FRMCODE_ECHO_REQ){
+        //the reply carries back the request tick, with the same header profile
+        //(if sending fails it's considered as lost on the line)
+        if(line->txFunc!=NULL) sendFrame(line,FRMCODE_ECHO_REP,0,header->hash,tickArray,sizeof(tickArray),headerLen==COMPACT_HEADER_LEN);
+        return;
+    }
+
+    rttSample(line,sdlTimeTick()-netToNum32(tickArray));
+    line->pingRxSeq=header->hash;
+}
+
+//sends the automatic echo request if its period expired
+void pingService(serial_line_handle* line){
+    if(!line->pingPeriod || line->txFunc==NULL) return;
+
+    uint32_t now=sdlTimeTick();
+    if((now-line->pingLast)<line->pingPeriod) return;
+
+    line->pingLast=now;
+    sendEcho(line);
+}
+#endif
+
+//prepares a scan of line rxBuff searching for frameCode frames, the scan is
+//advanced on dummyBuff (a copy of rxBuff handle) by scanFrame()
+//returns 0 if the scan can be skipped, !0 otherwise
+uint8_t startScan(serial_line_handle* line, uint8_t frameCode, circular_buffer_handle* dummyBuff){
     //initializing temporary circular buffer
-    cBuffInit(&line->tmpBuff,line->tmpBuffArray,sizeof(line->tmpBuffArray),0);
+    cBuffInit(&line->tmpBuff,line->tmpBuff.buff,line->tmpBuff.buffLen,0);
 
-    //fill the rxBuffer with new bytes
-    uint8_t byte;
-    while(!cBuffFull(&line->rxBuff)){
-        if(line->rxFunc(&byte)){
-            cBuffPush(&line->rxBuff,&byte,1,1);
-        }else break;
+    //fill the rxBuffer with new bytes (new bytes can contain any frame)
+    if(fillRxBuff(line)) line->rxScanMiss=0;
+
+    //collapse consecutive flags at the buffer head (closing flags left
+    //by cut frames followed by the opening flag of a new frame)
+    while(line->rxBuff.elemNum>=2 && cBuffReadByte(&line->rxBuff,0,0)==FRAME_FLAG && cBuffReadByte(&line->rxBuff,0,1)==FRAME_FLAG){
+        cBuffPull(&line->rxBuff,NULL,1,0);
     }
+
+    //nothing arrived since the last scan which didn't find this code
+    if(line->rxScanMiss & SCANMISS(frameCode)) return 0;
+
+    //copying rxBuff into dummy buffer
+    cBuffToCirc(dummyBuff,&line->rxBuff);
+
+    return 1;
+}
+
+//continues a scan started by startScan(), searching for a certain frameCode, if some remCodes are specified
+//(not NULL or empty) it also removes those codes from rxBuff, otherwise it leaves them unchanged
+//the eventually received frame will be placed inside line tmpBuff (HEADER INCLUDED!) and the scan
+//can be continued after it by calling this function again
+//returns 0 if no frame found, !0 otherwise
+uint8_t scanFrame(serial_line_handle* line, circular_buffer_handle* dummyBuff, uint8_t frameCode, circular_buffer_handle* remCodes){
+    //frames can't be longer than the line buffers
+    search_frame_rule lineRule=rule;
+    lineRule.maxLen=SDL_LINE_BUFF_LEN(line->maxPayLen)-2;
    
     //handle to store found frames
     circular_buffer_handle frameHandle;
-    //dummy buffer to perform buffer advancement
-    circular_buffer_handle dummyBuff;
-    //copying rxBuff into dummy buffer
-    cBuffToCirc(&dummyBuff,&line->rxBuff);
     //we search on dummy handle, shifting it out to current found frame
-    while(searchFrameAdvance(&dummyBuff,&frameHandle,&rule,SHIFTOUT_NEXT | SHIFTOUT_FAST)){
+    while(searchFrameAdvance(dummyBuff,&frameHandle,&lineRule,SHIFTOUT_NEXT | SHIFTOUT_FAST)){
         //flush tmp buffer
         cBuffFlush(&line->tmpBuff);
         //copy on temporary buffer
         cBuffPushRead(&line->tmpBuff,&frameHandle,frameHandle.elemNum,1,0);
         //try deframing
-        if(!deframe(&line->tmpBuff)) continue;
+        if(!deframe(&line->tmpBuff,line->crcType)){
+#ifdef SDL_TRACE_LEN
+            //logging every broken frame once (flag pairs between frames are not frames)
+            uint32_t brokenIndx=cBuffGetVirtIndex(&line->rxBuff,frameHandle.startIndex);
+            if(frameHandle.elemNum>2 && (brokenIndx!=line->traceCrcIndx || frameHandle.elemNum!=line->traceCrcLen)){
+                line->traceCrcIndx=brokenIndx;
+                line->traceCrcLen=frameHandle.elemNum;
+                traceCapture(line,&frameHandle);
+                traceEvent(line,SDL_TRACE_CRC,0,0);
+            }
+#endif
+            continue;
+        }
 
         //check if it corresponds to wanted frame code
         frameHeader tmpHeader;
         uint8_t toBeCut=0; //flag to signal that frame needs to be cut from rxBuff
         uint8_t found=0; //frame found flag
-        //reading header
-        if(cBuffRead(&line->tmpBuff,(uint8_t *)&tmpHeader,sizeof(frameHeader),0,0)!=sizeof(frameHeader)) continue;
-        //host ordering header
-        tmpHeader.hash=netToNum16((uint8_t*)&tmpHeader.hash);
-        if(line->tmpBuff.elemNum>(SDL_MAX_PAY_LEN+sizeof(frameHeader))) continue;
-        if(tmpHeader.code==frameCode){
+        //reading header (host ordered)
+        uint32_t headerLen=readHeader(&line->tmpBuff,&tmpHeader);
+        if(!headerLen) continue;
+        if(line->tmpBuff.elemNum>(line->maxPayLen+headerLen)) continue;
+        if(tmpHeader.code==FRMCODE_CREDIT || tmpHeader.code==FRMCODE_ECHO_REQ || tmpHeader.code==FRMCODE_ECHO_REP){
+            //control frames are always removed and handled here
+            toBeCut=1;
+        }else if(tmpHeader.code==frameCode){
             //frame found
             toBeCut=1;
             found=1;
         }else{
             if(remCodes!=NULL){
                 for(uint32_t c=0; c<remCodes->elemNum; c++){
-                    if(cBuffReadByte(remCodes,0,c)==tmpHeader.hash){
+                    if(cBuffReadByte(remCodes,0,c)==tmpHeader.code){
                         toBeCut=1;
                         break;
                     }
                 }
+#ifdef SDL_ASYNC
+                //the ack of the pending asynchronous frame is left for sdlPoll()
+                if(tmpHeader.code==FRMCODE_ACK && line->txState==SDL_TX_WAIT_ACK && tmpHeader.hash==line->txHash){
+                    toBeCut=0;
+                }
+#endif
             }
         }
 
@@ -431,36 +1051,140 @@ uint8_t receiveFrame(serial_line_handle* line, uint8_t frameCode, circular_buffe
             //we cut the found frame from buffers
             //saving the virtual index of the found frame inside rxBuff
             uint32_t frameIndx=cBuffGetVirtIndex(&line->rxBuff,frameHandle.startIndex);
-            //cutting found frame from rxBuff
-            cBuffCut(&line->rxBuff,NULL,frameHandle.elemNum,0,frameIndx);
-            //reconstructing dummy buffer
-            cBuffToCirc(&dummyBuff,&line->rxBuff);
-            cBuffPull(&dummyBuff,NULL,frameIndx+1,0);
+#ifdef SDL_FLOW_CTRL
+            uint32_t rxFrom=line->rxBuff.elemNum-frameIndx;
+#endif
+            //cutting found frame from rxBuff, leaving the closing flag which
+            //can also be the opening flag of the next frame (shared flags),
+            //unless a flag already precedes the frame (frames left in rxBuff
+            //would otherwise pile up flags behind them, never collapsed)
+            uint32_t cutLen=frameHandle.elemNum-1;
+            uint32_t scanIndx=frameIndx;
+            if(frameIndx && cBuffReadByte(&line->rxBuff,0,frameIndx-1)==FRAME_FLAG){
+                cutLen++;
+                scanIndx--;
+            }
+            cBuffCut(&line->rxBuff,NULL,cutLen,0,frameIndx);
+            //reconstructing dummy buffer (starting from the flag left)
+            cBuffToCirc(dummyBuff,&line->rxBuff);
+            cBuffPull(dummyBuff,NULL,scanIndx,0);
+
+#ifdef SDL_TRACE_LEN
+            //logged before handling, which can send frames
+            traceCapture(line,&line->tmpBuff);
+            traceEvent(line,SDL_TRACE_RX,tmpHeader.hash,0);
+#endif
+
+#ifdef SDL_FLOW_CTRL
+            if(tmpHeader.code==FRMCODE_CREDIT || tmpHeader.code==FRMCODE_ACK){
+                handleCredit(line,&tmpHeader,headerLen,rxFrom);
+            }
+#endif
+#ifdef SDL_PING
+            if(tmpHeader.code==FRMCODE_ECHO_REQ || tmpHeader.code==FRMCODE_ECHO_REP){
+                handleEcho(line,&tmpHeader,headerLen);
+            }
+#endif
         }
 
         if(found) return 1;
     }
 
+    line->rxScanMiss|=SCANMISS(frameCode);
+
     return 0;
 }
 
+//receives a frame from line rxBuff, searching for a certain frameCode, if some remCodes are specified (not NULL or empty)
+//it also removes those codes from rxBuff, otherwise it leaves them unchanged
+//the eventually received frame will be placed inside line tmpBuff (HEADER INCLUDED!)
+//returns 0 if no frame found, !0 otherwise
+uint8_t receiveFrame(serial_line_handle* line, uint8_t frameCode, circular_buffer_handle* remCodes){
+    if(line==NULL || !HAS_RX(line)) return 0;
+
+    //dummy buffer to perform buffer advancement
+    circular_buffer_handle dummyBuff;
+    if(!startScan(line,frameCode,&dummyBuff)) return 0;
+
+    return scanFrame(line,&dummyBuff,frameCode,remCodes);
+}
+
 //COMPLEX I/O FUNCTIONS -------------------------------------------------------
 
+//gives the payload inside line tmpBuff to the line handler
+//the payload is given in place if it's contiguous, otherwise it's copied
+void dispatchFrame(serial_line_handle* line){
+    circular_buffer_handle* payload=&line->tmpBuff;
+
+    //a shared buffer would be overwritten if the handler sends on another line
+    if(!line->tmpShared && (payload->startIndex+payload->elemNum)<=payload->buffLen){
+        line->rxHandler(line,&payload->buff[payload->startIndex],payload->elemNum,line->rxHandlerCtx);
+    }else{
+        uint8_t payloadArray[SDL_MAX_PAY_LEN];
+        cBuffRead(payload,payloadArray,payload->elemNum,0,0);
+        line->rxHandler(line,payloadArray,payload->elemNum,line->rxHandlerCtx);
+    }
+}
+
+//decompresses the payload inside line tmpBuff (in place)
+//returns 0 if the payload is not valid (or compression is not enabled), !0 otherwise
+uint8_t decompressFrame(serial_line_handle* line){
+#ifdef SDL_COMPRESS_HASH_BITS
+    uint8_t packed[SDL_MAX_PAY_LEN];
+    uint8_t plain[SDL_MAX_PAY_LEN];
+
+    if(line->tmpBuff.elemNum>sizeof(packed)) return 0;
+    uint32_t packedLen=cBuffRead(&line->tmpBuff,packed,line->tmpBuff.elemNum,0,0);
+    uint32_t plainLen=lzfDecompress(packed,packedLen,plain,line->maxPayLen);
+    if(!plainLen) return 0;
+
+    cBuffFlush(&line->tmpBuff);
+    cBuffPush(&line->tmpBuff,plain,plainLen,1);
+
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+//sends the ack of a received frame (with the compact header if compact is !0)
+//if ack sending fails it's considered as lost on the line
+void ackFrame(serial_line_handle* line, uint16_t hash, uint8_t compact){
+#ifdef SDL_FLOW_CTRL
+    //with flow control the ack carries the credit limit
+    uint8_t limitArray[2];
+    uint32_t limitLen=0;
+    if(line->flowControl){
+        line->rxAdvertised=creditLimit(line);
+        num16ToNet(limitArray,line->rxAdvertised);
+        limitLen=sizeof(limitArray);
+    }
+
+    sendFrame(line,FRMCODE_ACK,0,hash,limitLen ? limitArray : NULL,limitLen,compact);
+#else
+    sendFrame(line,FRMCODE_ACK,0,hash,NULL,0,compact);
+#endif
+}
+
 //receive a frame and eventually acknowledge it
 //returns the length of frame if received, 0 otherwise
 //searches for a frame with code frameCode, and eventually removes remCodes frames from rxBuff (if not NULL or empty)
 //pushes the received code in rxFrame tail, if not NULL, ONLY pushing if there's enough space
-//if there's not enough space to store the frame, the ack is not sent even if requested
-uint32_t receiveFrameAndAck(serial_line_handle* line, circular_buffer_handle* rxFrame, uint8_t frameCode, circular_buffer_handle* remCodes){
-    if(line==NULL || line->rxFunc==NULL) return 0;
+//if there's not enough space to store the frame, it's dropped and the ack is not sent even if requested
+//if the line has a handler, the frame is given to it instead of being pushed in rxFrame
+//the frame header (host ordered) is written in rxHeader, if not NULL
+uint32_t receiveFrameAndAck(serial_line_handle* line, circular_buffer_handle* rxFrame, uint8_t frameCode, circular_buffer_handle* remCodes, frameHeader* rxHeader){
+    if(line==NULL || !HAS_RX(line)) return 0;
     
     //if frame received
     if(receiveFrame(line, frameCode,remCodes)){
-        //get header
+        //get header (host ordered)
         frameHeader tmpHeader;
-        cBuffPull(&line->tmpBuff,(uint8_t *)&tmpHeader,sizeof(frameHeader),0);
-        //host ordering header
-        tmpHeader.hash=netToNum16((uint8_t*)&tmpHeader.hash);
+        uint32_t headerLen=readHeader(&line->tmpBuff,&tmpHeader);
+        cBuffPull(&line->tmpBuff,NULL,headerLen,0);
+
+        //frames which can't be decompressed are discarded (without ack)
+        if((tmpHeader.ackWanted & FRMFLAG_COMPRESSED) && !decompressFrame(line)) return 0;
 
         uint8_t sendAck=1;
         uint32_t len=line->tmpBuff.elemNum;
@@ -468,21 +1192,36 @@ uint32_t receiveFrameAndAck(serial_line_handle* line, circular_buffer_handle* rx
         if(tmpHeader.hash == line->lastRxHash){
             len=0; 
         }else{
-            if(rxFrame!=NULL){
+            if(line->rxHandler!=NULL){
+                //handler called before the ack, which overwrites tmpBuff
+                dispatchFrame(line);
+            }else if(rxFrame!=NULL){
                 //pushing it on buffer (if enough space)
                 if((rxFrame->buffLen-rxFrame->elemNum)>=len){
                     cBuffPushPull(rxFrame, &line->tmpBuff, len, 1,0);
-                }else sendAck=0;
+                }else{
+                    sendAck=0;
+                    len=0;
+                    line->rxDropped++;
+                }
             }
         }
 
+        if(rxHeader!=NULL) *rxHeader=tmpHeader;
+
         //send ack back if needed (if ack sending fails it's considered as lost on the line, the frame is received anyway)
-        if(tmpHeader.ackWanted && sendAck){ 
-            sendFrame(line, FRMCODE_ACK, 0, tmpHeader.hash,NULL,0);
+        if((tmpHeader.ackWanted & FRMFLAG_ACK) && sendAck){ 
+            //the ack uses the same header profile of the frame
+            ackFrame(line,tmpHeader.hash,headerLen==COMPACT_HEADER_LEN);
             //saving last acknowledged hash
             line->lastRxHash=tmpHeader.hash;
         }
 
+#ifdef SDL_FLOW_CTRL
+        //the frame left space inside rxBuff
+        updateCredit(line);
+#endif
+
         return len;
     }
 
@@ -490,19 +1229,28 @@ uint32_t receiveFrameAndAck(serial_line_handle* line, circular_buffer_handle* rx
 
 }
 
-//tries receiving a single ack with the given hash
-//to be called multiple times to scan the whole buffer
+//inits remCodes with the codes removed from rxBuff while receiving data frames (old acks)
+void dataRemCodes(circular_buffer_handle* remCodes){
+    static uint8_t remCode[]={FRMCODE_ACK};
+    cBuffInit(remCodes,remCode,sizeof(remCode),sizeof(remCode));
+}
+
+//tries receiving an ack with the given hash
+//acks with a different hash are removed from rxBuff while scanning
 uint8_t receiveAck(serial_line_handle* line, uint16_t hash){
-    if(line==NULL || line->rxFunc==NULL) return 0;
+    if(line==NULL || !HAS_RX(line)) return 0;
 
-    if(receiveFrame(line,FRMCODE_ACK,NULL)){
-        //get header
+    while(receiveFrame(line,FRMCODE_ACK,NULL)){
+        //get header (host ordered)
         frameHeader tmpHeader;
-        cBuffPull(&line->tmpBuff,(uint8_t *)&tmpHeader,sizeof(frameHeader),0);
-        //host ordering header
-        tmpHeader.hash=netToNum16((uint8_t*)&tmpHeader.hash);
+        cBuffPull(&line->tmpBuff,NULL,readHeader(&line->tmpBuff,&tmpHeader),0);
         //check if hash correct
-        if(tmpHeader.hash == hash) return 1;
+        if(tmpHeader.hash == hash){
+#ifdef SDL_TRACE_LEN
+            traceEvent(line,SDL_TRACE_ACK,hash,0);
+#endif
+            return 1;
+        }
     }
 
     return 0;
@@ -510,77 +1258,378 @@ uint8_t receiveAck(serial_line_handle* line, uint16_t hash){
 }
 
 #ifdef SDL_ANTILOCK_DEPTH
-//receives frames placing them inside anti lock queue (and eventually responding with an ack)
-//returns 0 in case of failure, length of frame otherwise
-uint32_t receiveInQueueAndAck(serial_line_handle* line, uint8_t frameCode, circular_buffer_handle* remCodes){
-    if(line==NULL || line->rxFunc==NULL) return 0;
+//gets the contiguous free space of the frame pool where the next frame will be placed
+//frames never wrap around the pool end, so they can be given by reference
+//returns the length of the free space (0 if descriptors are full), its offset is written in offset
+uint32_t poolFreeSpan(serial_line_handle* line, uint32_t* offset){
+    if(line->alockNum==SDL_ANTILOCK_DEPTH) return 0;
+
+    //empty pool, restarting from the beginning
+    if(!line->alockNum){
+        line->alockPoolTail=0;
+        *offset=0;
+        return line->alockPoolLen;
+    }
 
-    //check if there's space in antiLockQueue
-    if(line->alockQueue.elemNum==line->alockQueue.buffLen) return 0;
+    //offset of the oldest frame
+    uint32_t head=line->alockDescs[line->alockHead].data-line->alockPool;
+    uint32_t tail=line->alockPoolTail;
 
-    //otherwise try receiving a frame
-    uint32_t len=receiveFrameAndAck(line,&line->alockBuff, frameCode, remCodes);
+    //the tail never reaches the oldest frame (tail==head only if the pool is empty)
+    if(tail<head){
+        *offset=tail;
+        return head-tail-1;
+    }
+
+    //space after the newest frame, or before the oldest one if a frame of
+    //maximum length doesn't fit at the end of the pool
+    if((line->alockPoolLen-tail)>=line->maxPayLen){
+        *offset=tail;
+        return line->alockPoolLen-tail;
+    }
+    *offset=0;
+    return head ? head-1 : 0;
+}
+
+//receives frames parking them inside the frame pool (and eventually responding with an ack)
+//returns 0 in case of failure, length of frame otherwise
+uint32_t receiveInQueueAndAck(serial_line_handle* line, uint8_t frameCode, circular_buffer_handle* remCodes){
+    if(line==NULL || !HAS_RX(line)) return 0;
+
+    //frames are given directly to the handler, if any
+    if(line->rxHandler!=NULL) return receiveFrameAndAck(line,NULL,frameCode,remCodes,NULL);
+
+    //check if there's space in the pool (frames are left in rxBuff until any
+    //frame can fit, so that they are never dropped for lack of space)
+    uint32_t offset=0;
+    uint32_t span=poolFreeSpan(line,&offset);
+    if(span<line->maxPayLen) return 0;
+
+    //otherwise try receiving a frame directly inside the pool
+    circular_buffer_handle poolHandle;
+    cBuffInit(&poolHandle,&line->alockPool[offset],span,0);
+    frameHeader header;
+    uint32_t len=receiveFrameAndAck(line,&poolHandle,frameCode,remCodes,&header);
 
     //if frame received
     if(len){
-        cBuffPush(&line->alockQueue,(uint8_t*)&len,sizeof(line->tmpBuff.elemNum),1);
+        sdl_frame_desc* desc=&line->alockDescs[(line->alockHead+line->alockNum)%SDL_ANTILOCK_DEPTH];
+        desc->data=&line->alockPool[offset];
+        desc->len=len;
+        desc->timestamp=sdlTimeTick();
+        desc->seq=header.hash;
+        desc->channel=header.code;
+        line->alockNum++;
+        line->alockPoolTail=offset+len;
     }
 
     return len;
 }
 
+//removes the oldest frame from the pool
+void releaseFromQueue(serial_line_handle* line){
+    line->alockHead=(line->alockHead+1)%SDL_ANTILOCK_DEPTH;
+    line->alockNum--;
+}
+
 //reads a frame from anti lock queue
 //returns length of frame, otherwise 0
-//places frame inside rxFrame (if not null), only if there's enough space
-uint32_t readFromQueue(serial_line_handle* line, circular_buffer_handle* rxFrame){
-    if(line==NULL) return 0;
-
-    //check if there are frames in queue
-    uint32_t frameLen=0;
-    cBuffPull(&line->alockQueue,(uint8_t*)&frameLen,sizeof(frameLen),0);
-
-    //read frame from queue
-    if(rxFrame!=NULL){
-        //pushing it on buffer (if enough space)
-        uint32_t len=frameLen;
-        if((rxFrame->buffLen-rxFrame->elemNum)>=len){
-            cBuffPushPull(rxFrame, &line->alockBuff, len, 1,0);
-        }else{
-            //otherwise just discard the frame
-            cBuffPull(&line->alockBuff,NULL,len,0);
-            return 0;
-        }
+//copies the frame inside buff, only if there's enough space (otherwise it's dropped)
+uint32_t readFromQueue(serial_line_handle* line, uint8_t* buff, uint32_t len){
+    if(line==NULL || !line->alockNum) return 0;
+
+    sdl_frame_desc* desc=&line->alockDescs[line->alockHead];
+    uint32_t frameLen=desc->len;
+    if(frameLen<=len){
+        for(uint32_t b=0;b<frameLen;b++) buff[b]=desc->data[b];
+    }else{
+        frameLen=0;
+        line->rxDropped++;
     }
 
+    releaseFromQueue(line);
+
     return frameLen;
 }
 #endif
 
-// SIMPLE DATA LINK FUNCTIONS -------------------------------------------------
-void sdlInitLine(serial_line_handle* line, uint8_t (*txFunc)(uint8_t byte), uint8_t (*rxFunc)(uint8_t* byte), uint32_t timeout, uint32_t retries){
-    if(line==NULL) return;
+// WAITS ----------------------------------------------------------------------
+//returns the ticks left before deadline (the last tick of a wait), 0 if it passed
+uint32_t ticksLeft(uint32_t deadline){
+    uint32_t now=sdlTimeTick();
+    return ((int32_t)(deadline-now)>=0) ? deadline-now+1 : 0;
+}
+
+//waits until cond returns !0 (it's given ctx) or deadline passes, filling the
+//anti-lock queue and sleeping inside the wait hook (if any) meanwhile
+//returns !0 if cond was met, 0 on timeout
+uint8_t waitUntil(serial_line_handle* line, uint8_t (*cond)(serial_line_handle* line, void* ctx), void* ctx, uint32_t deadline){
+#ifdef SDL_WAIT_HOOK
+    //read before checking the line, so no notification gets lost
+    uint32_t seq=wakeSeq(line);
+#endif
+    while(!cond(line,ctx)){
+        uint32_t ticks=ticksLeft(deadline);
+        if(!ticks) return 0;
+
+#ifdef SDL_ANTILOCK_DEPTH
+        //if anti lock active, fill the queue while waiting
+        receiveInQueueAndAck(line,FRMCODE_DATA,NULL);
+#endif
+
+#ifdef SDL_WAIT_HOOK
+        //sleeping until new bytes arrive
+        waitWake(line,&seq,ticks);
+#endif
+    }
+
+    return 1;
+}
+
+//wait condition: the ack of the frame with hash *ctx was received
+uint8_t ackReceived(serial_line_handle* line, void* ctx){
+    return receiveAck(line,*(uint16_t*)ctx);
+}
+
+#ifdef SDL_PING
+//wait condition: the reply of the echo request with sequence number *ctx was received
+uint8_t echoReceived(serial_line_handle* line, void* ctx){
+    //echo replies are handled by any scan, never returned
+    receiveFrame(line,FRMCODE_ECHO_REP,NULL);
+    return line->pingRxSeq==*(uint8_t*)ctx;
+}
+#endif
+
+#ifdef SDL_FLOW_CTRL
+//probes the receiver if a data frame is held and no credit arrived within the line timeout
+void probeCredit(serial_line_handle* line){
+    if(!line->txBlocked || (sdlTimeTick()-line->txBlockTick)<=line->timeout) return;
+
+    line->txBlockTick=sdlTimeTick();
+    sendCredit(line,1,line->txSent);
+}
+
+//handles the credit frames received by the line and probes the receiver if needed
+void collectCredit(serial_line_handle* line){
+    //credit frames are handled by any scan, never returned
+    receiveFrame(line,FRMCODE_CREDIT,NULL);
+    probeCredit(line);
+}
+
+//wait condition: the credit limit moved from *ctx
+uint8_t creditMoved(serial_line_handle* line, void* ctx){
+    collectCredit(line);
+    return line->txLimit!=*(uint16_t*)ctx;
+}
+
+//waits for new credits while a data frame is held
+//returns !0 if the receiver advertised a new limit, 0 on timeout
+uint8_t waitCredit(serial_line_handle* line){
+    uint16_t limit=line->txLimit;
+    uint32_t deadline=sdlTimeTick()+line->timeout;
+
+    while(1){
+        //never sleeping past the next credit probe
+        uint32_t probe=line->txBlockTick+line->timeout;
+        uint32_t until=((int32_t)(probe-deadline)<0) ? probe : deadline;
+        if(waitUntil(line,creditMoved,&limit,until)) return 1;
+        if(until==deadline) return 0;
+    }
+}
+#endif
+
+#ifdef SDL_PACING
+//wait condition: the pacing allows the held data frame
+uint8_t rateReady(serial_line_handle* line, void* ctx){
+    return rateAvail(line,line->ratePending);
+}
+
+//waits for the tokens of the data frame held by the pacing
+void waitRate(serial_line_handle* line){
+    //sleeping until the tick the tokens are refilled
+    while(!waitUntil(line,rateReady,NULL,sdlTimeTick()+rateTicks(line)-1));
+    line->ratePending=0;
+}
+#endif
 
+// SIMPLE DATA LINK FUNCTIONS -------------------------------------------------
+//inits all the line members except the buffers memory
+void initLine(serial_line_handle* line, uint8_t (*txFunc)(uint8_t byte), uint8_t (*rxFunc)(uint8_t* byte), uint32_t timeout, uint32_t retries, uint32_t maxPayLen){
     line->txFunc=txFunc;
     line->rxFunc=rxFunc;
-    cBuffInit(&line->rxBuff,line->rxBuffArray,sizeof(line->rxBuffArray),0);
     line->timeout=timeout;
     line->retries=retries;
+    line->maxPayLen=maxPayLen;
     line->lastRxHash=0;
+    line->compactHeader=0;
+    line->crcType=SDL_CRC16;
+#ifdef SDL_COMPRESS_HASH_BITS
+    line->compress=0;
+#endif
+    line->hashCnt=0;
+    line->txSeq=0;
+    line->rxScanMiss=0;
+    line->rxHandler=NULL;
+    line->rxHandlerCtx=NULL;
+    line->rxDropped=0;
+#ifdef SDL_FLOW_CTRL
+    line->flowControl=0;
+    line->rxIn=0;
+    line->rxAdvertised=0;
+    line->txSent=0;
+    line->txLimit=0;
+    line->txCredited=0;
+    line->txBlocked=0;
+    line->txBlockTick=0;
+#endif
+#ifdef SDL_PACING
+    line->rateBytes=0;
+    line->rateBurst=0;
+    line->rateTokens=0;
+    line->rateTick=0;
+    line->ratePending=0;
+#endif
+#ifdef SDL_PING
+    line->pingSeq=0;
+    line->pingRxSeq=0;
+    line->pingPeriod=0;
+    line->pingLast=0;
+    line->rtt=(sdl_rtt_stats){0};
+    line->rttSum=0;
+    line->rttJitter=0;
+#endif
+
+#ifdef SDL_ANTILOCK_DEPTH
+    line->alockHead=0;
+    line->alockNum=0;
+    line->alockOut=0;
+    line->alockPoolTail=0;
+#endif
+
+#ifdef SDL_RX_RING_LEN
+    atomic_store_explicit(&line->rxRingHead,0,memory_order_relaxed);
+    atomic_store_explicit(&line->rxRingTail,0,memory_order_relaxed);
+#endif
+
+#ifdef SDL_TXQ_DEPTH
+    atomic_store_explicit(&line->txqTail,0,memory_order_relaxed);
+    line->txqHead=0;
+    for(uint32_t q=0;q<SDL_TXQ_DEPTH;q++) atomic_store_explicit(&line->txqSlots[q].seq,q,memory_order_relaxed);
+#endif
+
+#ifdef SDL_TX_BURST_LEN
+    line->txBurstFunc=NULL;
+#ifdef SDL_TRACE_LEN
+    line->traceBurstNum=0;
+#endif
+#endif
+
+#ifdef SDL_TRACE_LEN
+    line->traceHead=0;
+    line->traceCrcIndx=0;
+    line->traceCrcLen=0;
+#endif
+
+#ifdef SDL_WAIT_HOOK
+    line->waitFunc=NULL;
+    line->wakeFunc=NULL;
+    line->waitCtx=NULL;
+    atomic_store_explicit(&line->wakeSeq,0,memory_order_relaxed);
+    atomic_store_explicit(&line->wakeWaiting,0,memory_order_relaxed);
+#endif
+
+#ifdef SDL_ASYNC
+    line->txState=SDL_TX_IDLE;
+    line->txHash=0;
+    line->txRetry=0;
+    line->txStart=0;
+    line->txLen=0;
+#endif
+}
+
+#ifdef SDL_STATIC_BUFFERS
+void sdlInitLine(serial_line_handle* line, uint8_t (*txFunc)(uint8_t byte), uint8_t (*rxFunc)(uint8_t* byte), uint32_t timeout, uint32_t retries){
+    if(line==NULL) return;
+
+    cBuffInit(&line->rxBuff,line->rxBuffArray,sizeof(line->rxBuffArray),0);
     cBuffInit(&line->tmpBuff,line->tmpBuffArray,sizeof(line->tmpBuffArray),0);
+    line->tmpShared=0;
+
+#ifdef SDL_ANTILOCK_DEPTH
+    line->alockPool=line->alockPoolArray;
+    line->alockPoolLen=sizeof(line->alockPoolArray);
+#endif
+
+#ifdef SDL_ASYNC
+    line->txPay=line->txPayArray;
+#endif
+
+    initLine(line,txFunc,rxFunc,timeout,retries,SDL_MAX_PAY_LEN);
+}
+#endif
+
+#ifdef SDL_ANTILOCK_DEPTH
+//frame pool length of lines with buffers in arena (scaled by their maximum payload)
+#define ARENA_POOL_LEN(payLen) ((uint32_t)(((uint64_t)SDL_ANTILOCK_POOL_LEN*(payLen))/SDL_MAX_PAY_LEN))
+#endif
+
+uint32_t sdlLineArenaLen(uint32_t maxPayLen, uint8_t sharedTmp){
+    //rxBuff and tmpBuff
+    uint32_t len=SDL_LINE_BUFF_LEN(maxPayLen);
+    if(!sharedTmp) len+=SDL_LINE_BUFF_LEN(maxPayLen);
 
 #ifdef SDL_ANTILOCK_DEPTH
-    cBuffInit(&line->alockBuff,line->alockBuffArray,sizeof(line->alockBuffArray),0);
-    cBuffInit(&line->alockQueue,line->alockQueueArray,sizeof(line->alockQueueArray),0);
+    len+=ARENA_POOL_LEN(maxPayLen);
+#endif
+
+#ifdef SDL_ASYNC
+    len+=maxPayLen;
 #endif
+
+    return len;
+}
+
+uint32_t sdlInitLineArena(serial_line_handle* line, uint8_t (*txFunc)(uint8_t byte), uint8_t (*rxFunc)(uint8_t* byte), uint32_t timeout, uint32_t retries, uint32_t maxPayLen, uint8_t* arena, uint32_t arenaLen, uint8_t* sharedTmp){
+    if(line==NULL || arena==NULL || maxPayLen==0 || maxPayLen>SDL_MAX_PAY_LEN) return 0;
+
+    uint32_t arenaUsed=sdlLineArenaLen(maxPayLen,sharedTmp!=NULL);
+    if(arenaLen<arenaUsed) return 0;
+
+    //carving the buffers from the arena
+    uint8_t* mem=arena;
+    cBuffInit(&line->rxBuff,mem,SDL_LINE_BUFF_LEN(maxPayLen),0);
+    mem+=SDL_LINE_BUFF_LEN(maxPayLen);
+    line->tmpShared=(sharedTmp!=NULL);
+    if(sharedTmp!=NULL){
+        cBuffInit(&line->tmpBuff,sharedTmp,SDL_LINE_BUFF_LEN(maxPayLen),0);
+    }else{
+        cBuffInit(&line->tmpBuff,mem,SDL_LINE_BUFF_LEN(maxPayLen),0);
+        mem+=SDL_LINE_BUFF_LEN(maxPayLen);
+    }
+
+#ifdef SDL_ANTILOCK_DEPTH
+    line->alockPool=mem;
+    line->alockPoolLen=ARENA_POOL_LEN(maxPayLen);
+    mem+=ARENA_POOL_LEN(maxPayLen);
+#endif
+
+#ifdef SDL_ASYNC
+    line->txPay=mem;
+    mem+=maxPayLen;
+#endif
+
+    initLine(line,txFunc,rxFunc,timeout,retries,maxPayLen);
+
+    return arenaUsed;
 }
 
 uint8_t sdlSend(serial_line_handle* line, uint8_t* buff, uint32_t len, uint8_t ackWanted){
     if(line==NULL || line->txFunc==NULL || buff==NULL || len==0) return 0;
 
-    if(len>SDL_MAX_PAY_LEN) return 0;
+    if(len>line->maxPayLen) return 0;
 
     //generating hash
-    uint16_t hash=computeHash(buff,len);
+    uint16_t hash=nextHash(line,buff,len);
 
     //try sending frame
     uint32_t retryNum=0;
@@ -588,7 +1637,24 @@ uint8_t sdlSend(serial_line_handle* line, uint8_t* buff, uint32_t len, uint8_t a
         retryNum++;
         
         //send data
-        if(!sendFrame(line,FRMCODE_DATA,ackWanted,hash,buff,len)) continue;
+        if(!sendFrame(line,FRMCODE_DATA,ackWanted,hash,buff,len,line->compactHeader)){
+            //waiting for tokens or credits doesn't count as a retry (as long as credits arrive)
+#ifdef SDL_PACING
+            if(line->ratePending){
+                waitRate(line);
+                retryNum--;
+                continue;
+            }
+#endif
+#ifdef SDL_FLOW_CTRL
+            if(line->txBlocked && waitCredit(line)) retryNum--;
+#endif
+            continue;
+        }
+
+#ifdef SDL_TRACE_LEN
+        if(retryNum>1) traceEvent(line,SDL_TRACE_RETRY,hash,retryNum-1);
+#endif
 
         if(!ackWanted) return 1;
 
@@ -596,42 +1662,712 @@ uint8_t sdlSend(serial_line_handle* line, uint8_t* buff, uint32_t len, uint8_t a
         __sdlTestSendCallback(line);
 #endif
 
-        //saving starting tick for timeout
-        uint32_t startTick=sdlTimeTick();
-        do{
-            if(receiveAck(line,hash)) return 1;
-
-#ifdef SDL_ANTILOCK_DEPTH
-        //if anti lock active, fill the queue while waiting
-        receiveInQueueAndAck(line,FRMCODE_DATA,NULL);
-#endif
-        }while((sdlTimeTick()-startTick)<=line->timeout);
+        //waiting for the ack until the timeout
+        if(waitUntil(line,ackReceived,&hash,sdlTimeTick()+line->timeout)) return 1;
 
     }while(retryNum<=line->retries);
 
+#ifdef SDL_TRACE_LEN
+    traceEvent(line,SDL_TRACE_TIMEOUT,hash,line->retries);
+#endif
+
     return 0;
 }
 
 uint32_t sdlReceive(serial_line_handle* line, uint8_t* buff, uint32_t len){
-    if(line==NULL || line->rxFunc==NULL) return 0;
+    if(line==NULL || !HAS_RX(line)) return 0;
 
     uint32_t retVal=0;
 
-    //temporary cBuffer
-    circular_buffer_handle dummyHandle;
-    cBuffInit(&dummyHandle, buff, len,0);
+#ifdef SDL_PING
+    pingService(line);
+#endif
 
 #ifdef SDL_ANTILOCK_DEPTH
+    //frames taken by reference must be released first
+    if(line->alockOut) return 0;
+
     //try reading from queue
-    retVal=readFromQueue(line, &dummyHandle);
+    retVal=readFromQueue(line, buff, len);
     if(retVal) return retVal;
 #endif
 
-    //otherwise try receiving a fresh frame
-    uint8_t remCode[]={FRMCODE_ACK}; //we remove old acks from buffer
+    //temporary cBuffer
+    circular_buffer_handle dummyHandle;
+    cBuffInit(&dummyHandle, buff, len,0);
+
+    //otherwise try receiving a fresh frame (removing old acks from buffer)
     circular_buffer_handle remCodes;
-    cBuffInit(&remCodes,remCode,sizeof(remCode),sizeof(remCode));
-    retVal=receiveFrameAndAck(line,&dummyHandle,FRMCODE_DATA,&remCodes);
+    dataRemCodes(&remCodes);
+    //duplicated frames return 0 but don't stop the reception (up to the
+    //budget), a scan which finds no data frame or a dropped frame does
+    uint32_t budget=SDL_RX_BUDGET;
+    uint32_t dropped=line->rxDropped;
+    do{
+        retVal=receiveFrameAndAck(line,&dummyHandle,FRMCODE_DATA,&remCodes,NULL);
+    }while(!retVal && --budget && line->rxDropped==dropped && !(line->rxScanMiss & SCANMISS(FRMCODE_DATA)));
 
     return retVal;
 }
+
+#ifdef SDL_ANTILOCK_DEPTH
+uint32_t sdlReceiveRef(serial_line_handle* line, sdl_frame_desc* desc){
+    if(line==NULL || desc==NULL || line->rxHandler!=NULL) return 0;
+
+    //no parked frames left, try receiving a fresh one inside the pool
+    if(line->alockOut==line->alockNum){
+        //we remove old acks from buffer
+        circular_buffer_handle remCodes;
+        dataRemCodes(&remCodes);
+        //duplicated frames return 0 but don't stop the reception (up to the budget)
+        uint32_t offset;
+        uint32_t budget=SDL_RX_BUDGET;
+        while(!receiveInQueueAndAck(line,FRMCODE_DATA,&remCodes)){
+            if((line->rxScanMiss & SCANMISS(FRMCODE_DATA)) || poolFreeSpan(line,&offset)<line->maxPayLen || !--budget) return 0;
+        }
+    }
+
+    *desc=line->alockDescs[(line->alockHead+line->alockOut)%SDL_ANTILOCK_DEPTH];
+    line->alockOut++;
+
+    return desc->len;
+}
+
+uint8_t sdlRelease(serial_line_handle* line){
+    if(line==NULL || !line->alockOut) return 0;
+
+    releaseFromQueue(line);
+    line->alockOut--;
+
+    return 1;
+}
+#endif
+
+uint32_t sdlReceiveBatch(serial_line_handle* line, sdl_frame_desc* descs, uint32_t maxDescs, uint8_t* arena, uint32_t arenaLen){
+    if(line==NULL || !HAS_RX(line) || descs==NULL || arena==NULL || line->rxHandler!=NULL) return 0;
+
+    uint32_t frameNum=0;
+    uint32_t arenaUsed=0;
+
+#ifdef SDL_ANTILOCK_DEPTH
+    //frames taken by reference must be released first
+    if(line->alockOut) return 0;
+
+    //parked frames come first (fresh frames are received only once the
+    //queue is empty, to keep the order)
+    while(line->alockNum && frameNum<maxDescs){
+        sdl_frame_desc* desc=&descs[frameNum];
+        *desc=line->alockDescs[line->alockHead];
+        if((arenaLen-arenaUsed)<desc->len) return frameNum;
+        for(uint32_t b=0;b<desc->len;b++) arena[arenaUsed+b]=desc->data[b];
+        desc->data=&arena[arenaUsed];
+        arenaUsed+=desc->len;
+        frameNum++;
+        releaseFromQueue(line);
+    }
+    if(line->alockNum) return frameNum;
+#endif
+
+    //we remove old acks from buffer
+    circular_buffer_handle remCodes;
+    dataRemCodes(&remCodes);
+
+    //acks are sent together after the scan
+    uint16_t ackHash[BATCH_ACKS];
+    uint8_t ackCompact[BATCH_ACKS];
+    uint32_t ackNum=0;
+
+    //a single scan of rxBuff, stopping when a frame of maximum length could
+    //not be stored (it would be lost, since frames are cut while scanning)
+    circular_buffer_handle dummyBuff;
+    if(startScan(line,FRMCODE_DATA,&dummyBuff)){
+        uint32_t tick=sdlTimeTick();
+        while(frameNum<maxDescs && (arenaLen-arenaUsed)>=line->maxPayLen && scanFrame(line,&dummyBuff,FRMCODE_DATA,&remCodes)){
+            //get header (host ordered)
+            frameHeader header;
+            uint32_t headerLen=readHeader(&line->tmpBuff,&header);
+            cBuffPull(&line->tmpBuff,NULL,headerLen,0);
+
+            //frames which can't be decompressed are discarded (without ack)
+            if((header.ackWanted & FRMFLAG_COMPRESSED) && !decompressFrame(line)) continue;
+
+            //frames already received are only acknowledged again
+            if(header.hash!=line->lastRxHash){
+                sdl_frame_desc* desc=&descs[frameNum++];
+                desc->data=&arena[arenaUsed];
+                desc->len=cBuffPull(&line->tmpBuff,desc->data,line->tmpBuff.elemNum,0);
+                desc->timestamp=tick;
+                desc->seq=header.hash;
+                desc->channel=header.code;
+                arenaUsed+=desc->len;
+            }
+
+            if(header.ackWanted & FRMFLAG_ACK){
+                if(ackNum==BATCH_ACKS){
+                    for(uint32_t a=0;a<ackNum;a++) ackFrame(line,ackHash[a],ackCompact[a]);
+                    ackNum=0;
+                }
+                ackHash[ackNum]=header.hash;
+                ackCompact[ackNum]=headerLen==COMPACT_HEADER_LEN;
+                ackNum++;
+                line->lastRxHash=header.hash;
+            }
+        }
+    }
+
+    for(uint32_t a=0;a<ackNum;a++) ackFrame(line,ackHash[a],ackCompact[a]);
+
+#ifdef SDL_FLOW_CTRL
+    //the frames left space inside rxBuff
+    updateCredit(line);
+#endif
+
+    return frameNum;
+}
+
+uint8_t sdlSetCrc(serial_line_handle* line, uint8_t crcType){
+    if(line==NULL || crcType>SDL_CRC32C) return 0;
+
+    line->crcType=crcType;
+
+    return 1;
+}
+
+#ifdef SDL_COMPRESS_HASH_BITS
+void sdlSetCompression(serial_line_handle* line, uint8_t compress){
+    if(line==NULL) return;
+
+    line->compress=compress ? 1 : 0;
+}
+#endif
+
+void sdlSetCompactHeader(serial_line_handle* line, uint8_t compact){
+    if(line==NULL) return;
+
+    line->compactHeader=compact ? 1 : 0;
+}
+
+#ifdef SDL_FLOW_CTRL
+void sdlSetFlowControl(serial_line_handle* line, uint8_t enable){
+    if(line==NULL) return;
+
+    line->flowControl=enable ? 1 : 0;
+    line->txCredited=0;
+    line->txBlocked=0;
+}
+#endif
+
+#ifdef SDL_PACING
+uint8_t sdlSetRateLimit(serial_line_handle* line, uint32_t bytesPerTick, uint32_t burst){
+    if(line==NULL || (bytesPerTick && !burst) || burst>INT32_MAX) return 0;
+
+    line->rateBytes=bytesPerTick;
+    line->rateBurst=burst;
+    line->rateTokens=burst;
+    line->ratePending=0;
+    if(bytesPerTick) line->rateTick=sdlTimeTick();
+
+    return 1;
+}
+#endif
+
+#ifdef SDL_PING
+uint8_t sdlPing(serial_line_handle* line, uint32_t* rtt){
+    if(line==NULL || line->txFunc==NULL || !HAS_RX(line)) return 0;
+
+    uint8_t seq=sendEcho(line);
+    if(!seq) return 0;
+
+    //waiting for the reply until the timeout
+    if(!waitUntil(line,echoReceived,&seq,sdlTimeTick()+line->timeout)) return 0;
+
+    if(rtt!=NULL) *rtt=line->rtt.last;
+
+    return 1;
+}
+
+void sdlSetPingPeriod(serial_line_handle* line, uint32_t period){
+    if(line==NULL) return;
+
+    line->pingPeriod=period;
+    //the first request is sent at the next service
+    if(period) line->pingLast=sdlTimeTick()-period;
+}
+
+uint8_t sdlRttStats(serial_line_handle* line, sdl_rtt_stats* stats){
+    if(line==NULL || stats==NULL) return 0;
+
+    *stats=line->rtt;
+
+    return 1;
+}
+
+uint32_t sdlRttTimeout(serial_line_handle* line){
+    if(line==NULL || !line->rtt.replies) return 0;
+
+    //never below the longest round trip seen, to avoid needless retransmissions
+    uint32_t timeout=line->rtt.avg+4*line->rtt.jitter;
+    if(timeout<line->rtt.max) timeout=line->rtt.max;
+
+    return timeout+1;
+}
+#endif
+
+void sdlSetRxHandler(serial_line_handle* line, void (*rxHandler)(serial_line_handle* line, uint8_t* buff, uint32_t len, void* ctx), void* ctx){
+    if(line==NULL) return;
+
+    line->rxHandler=rxHandler;
+    line->rxHandlerCtx=ctx;
+}
+
+uint32_t sdlDispatch(serial_line_handle* line){
+    if(line==NULL || !HAS_RX(line) || line->rxHandler==NULL) return 0;
+
+    uint32_t frameNum=0;
+
+#ifdef SDL_PING
+    pingService(line);
+#endif
+
+    //we remove old acks from buffer
+    circular_buffer_handle remCodes;
+    dataRemCodes(&remCodes);
+
+    //receive until a scan finds no data frame or the budget is over
+    //(duplicated frames return 0 but don't stop the loop)
+    uint32_t budget=SDL_RX_BUDGET;
+    do{
+        if(receiveFrameAndAck(line,NULL,FRMCODE_DATA,&remCodes,NULL)) frameNum++;
+    }while(--budget && !(line->rxScanMiss & SCANMISS(FRMCODE_DATA)));
+
+    return frameNum;
+}
+
+uint8_t sdlRxPending(serial_line_handle* line){
+    if(line==NULL || !HAS_RX(line)) return 0;
+
+    //the last data scan didn't reach the end of rxBuff
+    return !(line->rxScanMiss & SCANMISS(FRMCODE_DATA));
+}
+
+#ifdef SDL_ASYNC
+//saves the payload of a sent frame which waits for an ack (for retransmissions)
+void setPending(serial_line_handle* line, uint16_t hash, uint8_t* buff, uint32_t len){
+    for(uint32_t b=0;b<len;b++) line->txPay[b]=buff[b];
+    line->txLen=len;
+    line->txHash=hash;
+    line->txRetry=0;
+    line->txStart=sdlTimeTick();
+    line->txState=SDL_TX_WAIT_ACK;
+}
+
+uint8_t sdlSendAsync(serial_line_handle* line, uint8_t* buff, uint32_t len, uint8_t ackWanted){
+    if(line==NULL || line->txFunc==NULL || buff==NULL || len==0) return 0;
+
+    if(len>line->maxPayLen) return 0;
+
+    //only one frame at a time can wait for an ack
+    if(ackWanted && line->txState==SDL_TX_WAIT_ACK) return 0;
+
+    //generating hash
+    uint16_t hash=nextHash(line,buff,len);
+
+    if(!sendFrame(line,FRMCODE_DATA,ackWanted,hash,buff,len,line->compactHeader)){
+#ifdef SDL_FLOW_CTRL
+        if(line->txBlocked) collectCredit(line);
+#endif
+        return 0;
+    }
+
+    if(ackWanted) setPending(line,hash,buff,len);
+
+    return 1;
+}
+
+uint32_t sdlPoll(serial_line_handle* line, uint8_t* buff, uint32_t len){
+    if(line==NULL || !HAS_RX(line)) return 0;
+
+    //collect the ack of the pending frame
+    if(line->txState==SDL_TX_WAIT_ACK){
+        if(receiveAck(line,line->txHash)) line->txState=SDL_TX_ACKED;
+    }
+
+    return sdlReceive(line,buff,len);
+}
+
+//moves the timeout of the pending frame held by the pacing or by the flow control
+//so that it expires again at the first tick it can be sent (timers, like the
+//engine ones, are re-armed from txStart)
+void holdPending(serial_line_handle* line, uint32_t now){
+    uint32_t wait=1;
+#ifdef SDL_PACING
+    if(line->ratePending) wait=rateTicks(line);
+#endif
+
+    line->txStart=now+wait-line->timeout-1;
+}
+
+uint8_t sdlCheckTimeout(serial_line_handle* line){
+    if(line==NULL) return SDL_TX_IDLE;
+
+    if(line->txState!=SDL_TX_WAIT_ACK) return line->txState;
+
+    uint32_t now=sdlTimeTick();
+    if((now-line->txStart)<=line->timeout) return line->txState;
+
+    if(line->txRetry>=line->retries){
+        line->txState=SDL_TX_FAILED;
+#ifdef SDL_TRACE_LEN
+        traceEvent(line,SDL_TRACE_TIMEOUT,line->txHash,line->txRetry);
+#endif
+        return line->txState;
+    }
+
+    //retransmit (if sending fails it's considered as lost on the line)
+    if(!sendFrame(line,FRMCODE_DATA,1,line->txHash,line->txPay,line->txLen,line->compactHeader)){
+#ifdef SDL_PACING
+        //held by the pacing, retried once the tokens are refilled
+        if(line->ratePending){
+            holdPending(line,now);
+            return line->txState;
+        }
+#endif
+#ifdef SDL_FLOW_CTRL
+        //held by the flow control, retried at the next tick
+        if(line->txBlocked){
+            collectCredit(line);
+            holdPending(line,now);
+            return line->txState;
+        }
+#endif
+    }
+    line->txRetry++;
+    line->txStart=now;
+#ifdef SDL_TRACE_LEN
+    traceEvent(line,SDL_TRACE_RETRY,line->txHash,line->txRetry);
+#endif
+
+    return line->txState;
+}
+
+uint8_t sdlTxState(serial_line_handle* line){
+    if(line==NULL) return SDL_TX_IDLE;
+
+    return line->txState;
+}
+#endif
+
+#ifdef SDL_TXQ_DEPTH
+/* The queue is a bounded ring where every slot has a sequence number:
+ * a slot at position pos is free for producers when seq==pos and ready
+ * for the drainer when seq==pos+1, producers reserve positions with a
+ * compare and swap on the tail, while the head is owned by the drainer.
+ */
+uint8_t sdlEnqueue(serial_line_handle* line, uint8_t* buff, uint32_t len, uint8_t ackWanted){
+    if(line==NULL || buff==NULL || len==0) return 0;
+
+    if(len>line->maxPayLen) return 0;
+
+    //reserving a position
+    sdl_txq_slot* slot;
+    uint32_t pos=atomic_load_explicit(&line->txqTail,memory_order_relaxed);
+    while(1){
+        slot=&line->txqSlots[pos & (SDL_TXQ_DEPTH-1)];
+        uint32_t seq=atomic_load_explicit(&slot->seq,memory_order_acquire);
+        int32_t diff=(int32_t)(seq-pos);
+        if(diff==0){
+            //slot free, try taking it (pos is updated on failure)
+            if(atomic_compare_exchange_weak_explicit(&line->txqTail,&pos,pos+1,memory_order_relaxed,memory_order_relaxed)) break;
+        }else if(diff<0){
+            //slot still owned by the drainer, queue full
+            return 0;
+        }else{
+            //another producer took it
+            pos=atomic_load_explicit(&line->txqTail,memory_order_relaxed);
+        }
+    }
+
+    //filling the slot
+    for(uint32_t b=0;b<len;b++) slot->data[b]=buff[b];
+    slot->len=len;
+    slot->ackWanted=ackWanted;
+
+    //publishing it to the drainer
+    atomic_store_explicit(&slot->seq,pos+1,memory_order_release);
+
+    return 1;
+}
+
+#ifdef SDL_TX_BURST_LEN
+_Static_assert(SDL_TX_BURST_LEN>=SDL_LINE_BUFF_LEN(SDL_MAX_PAY_LEN),"SDL_TX_BURST_LEN must fit the longest frame");
+
+#ifdef SDL_TRACE_LEN
+//the burst is also written when the trace records of its frames are all used
+#define BURST_FULL(line,len) ((len)>SDL_TX_BURST_LEN || (line)->traceBurstNum==SDL_TXQ_DEPTH)
+
+//keeps the trace record of a frame added to the burst (captured by buildFrame())
+void traceBurstAdd(serial_line_handle* line, uint16_t hash){
+    line->traceBurst[line->traceBurstNum]=line->traceScratch;
+    line->traceBurst[line->traceBurstNum].hash=hash;
+    line->traceBurstNum++;
+}
+
+//logs the frames of the burst if it was written, then empties the burst records
+void traceBurstLog(serial_line_handle* line, uint8_t written){
+    for(uint32_t f=0;written && f<line->traceBurstNum;f++){
+        line->traceScratch=line->traceBurst[f];
+        traceEvent(line,SDL_TRACE_TX,line->traceBurst[f].hash,0);
+    }
+    line->traceBurstNum=0;
+}
+#else
+#define BURST_FULL(line,len) ((len)>SDL_TX_BURST_LEN)
+#endif
+
+//writes the burst on the line with a single call (if possible)
+//returns 0 if the burst could not be completely written, !0 otherwise
+uint8_t writeBurst(serial_line_handle* line, uint32_t len){
+    uint8_t written=1;
+
+    if(line->txBurstFunc!=NULL){
+        uint32_t sent=line->txBurstFunc(line->txBurstArray,len);
+#ifdef SDL_FLOW_CTRL
+        line->txSent+=sent;
+#endif
+        written=(sent==len);
+    }else{
+        for(uint32_t b=0;b<len;b++){
+            if(!line->txFunc(line->txBurstArray[b])){
+                written=0;
+                break;
+            }
+#ifdef SDL_FLOW_CTRL
+            line->txSent++;
+#endif
+        }
+    }
+
+#ifdef SDL_TRACE_LEN
+    //frames are logged only once they are on the line
+    traceBurstLog(line,written);
+#endif
+
+    return written;
+}
+#endif
+
+uint32_t sdlTxDrain(serial_line_handle* line){
+    if(line==NULL || line->txFunc==NULL) return 0;
+
+    uint32_t frameNum=0;
+#ifdef SDL_TX_BURST_LEN
+    uint32_t burstLen=0;
+#endif
+
+    while(1){
+        sdl_txq_slot* slot=&line->txqSlots[line->txqHead & (SDL_TXQ_DEPTH-1)];
+        uint32_t seq=atomic_load_explicit(&slot->seq,memory_order_acquire);
+        //slot not yet published, queue empty
+        if(seq!=(line->txqHead+1)) break;
+
+#ifdef SDL_TX_BURST_LEN
+        //the frame waits for the previous ack inside the queue
+        if(slot->ackWanted && line->txState==SDL_TX_WAIT_ACK) break;
+
+        uint16_t hash=nextHash(line,slot->data,slot->len);
+        if(!buildFrame(line,FRMCODE_DATA,slot->ackWanted,hash,slot->data,slot->len,line->compactHeader)) break;
+
+#ifdef SDL_FLOW_CTRL
+        //the frame stays in the queue if the burst would go past the receiver limit
+        if(line->flowControl){
+            if(!creditAvail(line,burstLen+line->tmpBuff.elemNum)){
+                holdCredit(line);
+                collectCredit(line);
+                break;
+            }
+            line->txBlocked=0;
+        }
+#endif
+
+#ifdef SDL_PACING
+        //the frame stays in the queue until the pacing allows it
+        if(!rateAvail(line,line->tmpBuff.elemNum)) break;
+        rateCharge(line,line->tmpBuff.elemNum);
+#endif
+
+        //consecutive frames share the flag byte between them
+        uint32_t skip=burstLen ? 1 : 0;
+        if(BURST_FULL(line,burstLen+line->tmpBuff.elemNum-skip)){
+            //burst full, if the write fails the frames are considered as lost on the line
+            writeBurst(line,burstLen);
+            burstLen=0;
+            skip=0;
+        }
+        cBuffPull(&line->tmpBuff,NULL,skip,0);
+        burstLen+=cBuffPull(&line->tmpBuff,&line->txBurstArray[burstLen],line->tmpBuff.elemNum,0);
+#ifdef SDL_TRACE_LEN
+        //logged once the burst is written
+        traceBurstAdd(line,hash);
+#endif
+
+        if(slot->ackWanted) setPending(line,hash,slot->data,slot->len);
+#else
+        //if the frame cannot be sent it stays in the queue for the next call
+        if(!sdlSendAsync(line,slot->data,slot->len,slot->ackWanted)) break;
+#endif
+
+        //giving the slot back to producers (for the next round of the ring)
+        atomic_store_explicit(&slot->seq,line->txqHead+SDL_TXQ_DEPTH,memory_order_release);
+        line->txqHead++;
+        frameNum++;
+    }
+
+#ifdef SDL_TX_BURST_LEN
+    if(burstLen) writeBurst(line,burstLen);
+#endif
+
+    return frameNum;
+}
+
+#ifdef SDL_TX_BURST_LEN
+void sdlSetTxBurstFunc(serial_line_handle* line, uint32_t (*txBurstFunc)(uint8_t* buff, uint32_t len)){
+    if(line==NULL) return;
+
+    line->txBurstFunc=txBurstFunc;
+}
+#endif
+#endif
+
+#ifdef SDL_RX_RING_LEN
+uint32_t sdlRxPush(serial_line_handle* line, const uint8_t* data, uint32_t len){
+    if(line==NULL || data==NULL) return 0;
+
+    uint32_t pushed=0;
+    while(pushed<len){
+        uint8_t* span;
+        uint32_t spanLen=sdlRxSpan(line,&span);
+        if(spanLen==0) break; //ring full
+        if(spanLen>(len-pushed)) spanLen=len-pushed;
+        for(uint32_t b=0;b<spanLen;b++) span[b]=data[pushed+b];
+        sdlRxCommit(line,spanLen);
+        pushed+=spanLen;
+    }
+
+    return pushed;
+}
+
+uint32_t sdlRxSpan(serial_line_handle* line, uint8_t** span){
+    if(line==NULL || span==NULL) return 0;
+
+    //only the producer writes the head, the tail needs acquire ordering so
+    //that the consumer has finished reading the bytes we are going to overwrite
+    uint32_t head=atomic_load_explicit(&line->rxRingHead,memory_order_relaxed);
+    uint32_t tail=atomic_load_explicit(&line->rxRingTail,memory_order_acquire);
+    uint32_t indx=head & (SDL_RX_RING_LEN-1);
+
+    uint32_t freeLen=SDL_RX_RING_LEN-(head-tail);
+    uint32_t spanLen=SDL_RX_RING_LEN-indx;
+    if(spanLen>freeLen) spanLen=freeLen;
+
+    *span=&line->rxRingArray[indx];
+    return spanLen;
+}
+
+void sdlRxCommit(serial_line_handle* line, uint32_t len){
+    if(line==NULL) return;
+
+    uint32_t head=atomic_load_explicit(&line->rxRingHead,memory_order_relaxed);
+    //release ordering publishes the written bytes before the new head
+    atomic_store_explicit(&line->rxRingHead,head+len,memory_order_release);
+
+#ifdef SDL_WAIT_HOOK
+    sdlNotify(line);
+#endif
+}
+#endif
+
+#ifdef SDL_WAIT_HOOK
+void sdlSetWaitFunc(serial_line_handle* line, void (*waitFunc)(serial_line_handle* line, uint32_t seq, uint32_t ticks, void* ctx), void (*wakeFunc)(serial_line_handle* line, void* ctx), void* ctx){
+    if(line==NULL) return;
+
+    line->waitFunc=waitFunc;
+    line->wakeFunc=wakeFunc;
+    line->waitCtx=ctx;
+}
+
+void sdlNotify(serial_line_handle* line){
+    if(line==NULL) return;
+
+    atomic_fetch_add(&line->wakeSeq,1);
+    //the wake function (usually a system call) is skipped if nobody is waiting
+    if(atomic_load(&line->wakeWaiting) && line->wakeFunc!=NULL) line->wakeFunc(line,line->waitCtx);
+}
+
+#ifdef __linux__
+void sdlFutexWait(serial_line_handle* line, uint32_t seq, uint32_t ticks, void* ctx){
+    (void)ctx;
+
+    uint64_t ns=(uint64_t)ticks*SDL_FUTEX_TICK_NS;
+    struct timespec timeout={.tv_sec=ns/1000000000, .tv_nsec=ns%1000000000};
+    //returns immediately if wakeSeq is no more seq
+    syscall(SYS_futex,&line->wakeSeq,FUTEX_WAIT_PRIVATE,seq,&timeout,NULL,0);
+}
+
+void sdlFutexWake(serial_line_handle* line, void* ctx){
+    (void)ctx;
+
+    syscall(SYS_futex,&line->wakeSeq,FUTEX_WAKE_PRIVATE,1,NULL,NULL,0);
+}
+#endif
+#endif
+
+#ifdef SDL_TRACE_LEN
+uint32_t sdlTraceDump(serial_line_handle* line, uint8_t (*writeFunc)(const uint8_t* buff, uint32_t len, void* ctx), void* ctx){
+    if(line==NULL || writeFunc==NULL) return 0;
+
+    //pcap file header (host ordered, nanosecond timestamps)
+    struct{
+        uint32_t magic;
+        uint16_t versionMajor;
+        uint16_t versionMinor;
+        int32_t thisZone;
+        uint32_t sigFigs;
+        uint32_t snapLen;
+        uint32_t linkType;
+    }fileHeader={0xA1B23C4D,2,4,0,0,TRACE_PSEUDO_LEN+SDL_TRACE_SNAP_LEN,TRACE_LINKTYPE};
+    if(!writeFunc((const uint8_t*)&fileHeader,sizeof(fileHeader),ctx)) return 0;
+
+    //records from the oldest one still inside the ring
+    uint32_t first=(line->traceHead>SDL_TRACE_LEN) ? line->traceHead-SDL_TRACE_LEN : 0;
+    uint32_t written=0;
+    for(uint32_t r=first;r!=line->traceHead;r++){
+        sdl_trace_rec* rec=&line->traceRing[r & (SDL_TRACE_LEN-1)];
+
+        struct{
+            uint32_t tsSec;
+            uint32_t tsNsec;
+            uint32_t inclLen;
+            uint32_t origLen;
+            uint8_t pseudo[TRACE_PSEUDO_LEN];
+            uint8_t cap[SDL_TRACE_SNAP_LEN];
+        }packet;
+        uint64_t ns=rec->time*SDL_TRACE_CLOCK_NS;
+        packet.tsSec=ns/1000000000;
+        packet.tsNsec=ns%1000000000;
+        packet.inclLen=TRACE_PSEUDO_LEN+rec->capLen;
+        packet.origLen=TRACE_PSEUDO_LEN+rec->frameLen;
+
+        //pseudo-header (network ordered)
+        packet.pseudo[0]=rec->event;
+        packet.pseudo[1]=rec->arg;
+        num16ToNet(&packet.pseudo[2],rec->hash);
+        num32ToNet(&packet.pseudo[4],rec->frameLen);
+        for(uint32_t b=0;b<rec->capLen;b++) packet.cap[b]=rec->cap[b];
+
+        if(!writeFunc((const uint8_t*)&packet,4*sizeof(uint32_t)+packet.inclLen,ctx)) break;
+        written++;
+    }
+
+    return written;
+}
+#endif
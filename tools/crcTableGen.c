@@ -0,0 +1,66 @@
+/**
+ * @file crcTableGen.c
+ * @brief CRC look-up tables generator
+ *
+ * Host program run by the Makefile to generate the CRC look-up tables used
+ * by simpleDataLink.c (printed on the standard output as a C header), so
+ * that changing a polynomial only needs the macros below to be changed.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define CRC16_POLY 0x1021 //CRC-16/CCITT polynomial (MSB first)
+#define CRC32_POLY 0xEDB88320 //CRC-32 polynomial (reflected)
+#define CRC32C_POLY 0x82F63B78 //CRC-32C (Castagnoli) polynomial (reflected)
+
+//prints the table of a MSB first 16 bit CRC
+void printCRC16LUT(const char* name, uint16_t poly){
+    printf("const uint16_t %s[]={\n",name);
+    for(uint32_t byteVal=0;byteVal<256;byteVal++){
+        uint16_t crc=byteVal<<8;
+        for(uint8_t bit=0;bit<8;bit++){
+            if(crc & 0x8000){
+                crc=(crc<<1) ^ poly;
+            }else{
+                crc=crc<<1;
+            }
+        }
+        printf("0x%04x, ",crc);
+        if(!((byteVal+1)%16)) printf("\n");
+    }
+    printf("};\n\n");
+}
+
+//prints the table of a reflected (LSB first) 32 bit CRC
+void printCRC32LUT(const char* name, uint32_t poly){
+    printf("const uint32_t %s[]={\n",name);
+    for(uint32_t byteVal=0;byteVal<256;byteVal++){
+        uint32_t crc=byteVal;
+        for(uint8_t bit=0;bit<8;bit++){
+            if(crc & 1){
+                crc=(crc>>1) ^ poly;
+            }else{
+                crc=crc>>1;
+            }
+        }
+        printf("0x%08x, ",crc);
+        if(!((byteVal+1)%8)) printf("\n");
+    }
+    printf("};\n\n");
+}
+
+int main(){
+    printf("//generated by tools/crcTableGen.c, do not edit\n\n");
+    printf("#ifndef CRCTABLES_H\n#define CRCTABLES_H\n\n");
+    printf("#define CRC16_POLY 0x%04x\n",CRC16_POLY);
+    printf("#define CRC32_POLY 0x%08x\n",CRC32_POLY);
+    printf("#define CRC32C_POLY 0x%08x\n\n",CRC32C_POLY);
+    printCRC16LUT("CRC16LUT",CRC16_POLY);
+    printCRC32LUT("CRC32LUT",CRC32_POLY);
+    printCRC32LUT("CRC32CLUT",CRC32C_POLY);
+    printf("#endif\n");
+
+    return 0;
+}